@@ -2,6 +2,7 @@
 #include "hwacha_xcpt.h"
 #include "mmu.h"
 #include "trap.h"
+#include "checkpoint.h"
 #include <stdexcept>
 
 REGISTER_EXTENSION(hwacha, []() { return new hwacha_t; })
@@ -30,6 +31,22 @@ void hwacha_t::reset()
     ut_state[i].reset();
 }
 
+void hwacha_t::save_state(FILE* f)
+{
+  checkpoint_write(f, &ct_state, sizeof(ct_state));
+  checkpoint_write(f, ut_state, sizeof(ut_state));
+  checkpoint_write(f, &cause, sizeof(cause));
+  checkpoint_write(f, &aux, sizeof(aux));
+}
+
+void hwacha_t::restore_state(FILE* f)
+{
+  checkpoint_read(f, &ct_state, sizeof(ct_state));
+  checkpoint_read(f, ut_state, sizeof(ut_state));
+  checkpoint_read(f, &cause, sizeof(cause));
+  checkpoint_read(f, &aux, sizeof(aux));
+}
+
 static reg_t custom(processor_t* p, insn_t insn, reg_t pc)
 {
   require_accelerator;
@@ -35,6 +35,8 @@ public:
   const char* name() { return "hwacha"; }
   void reset();
   void set_debug(bool value) { debug = value; }
+  void save_state(FILE* f);
+  void restore_state(FILE* f);
 
   ct_state_t* get_ct_state() { return &ct_state; }
   ut_state_t* get_ut_state(int idx) { return &ut_state[idx]; }
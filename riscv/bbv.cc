@@ -0,0 +1,57 @@
+// See LICENSE for license details.
+
+#include "bbv.h"
+#include <cinttypes>
+#include <cstdlib>
+
+bbv_t::bbv_t(const char* filename, uint64_t interval)
+  : interval(interval), interval_insns(0), block_start(0), block_insns(0)
+{
+  file = fopen(filename, "w");
+  if (!file)
+  {
+    fprintf(stderr, "couldn't open BBV file %s\n", filename);
+    exit(1);
+  }
+}
+
+bbv_t::~bbv_t()
+{
+  end_block();
+  if (interval_insns)
+    dump();
+  fclose(file);
+}
+
+void bbv_t::end_block()
+{
+  if (block_insns)
+  {
+    auto it = blocks.find(block_start);
+    if (it == blocks.end())
+      it = blocks.insert(std::make_pair(block_start, (block_t){blocks.size() + 1, 0})).first;
+    if (it->second.insns == 0)
+      touched.push_back(&it->second);
+    it->second.insns += block_insns;
+
+    interval_insns += block_insns;
+    block_insns = 0;
+
+    // intervals end on block boundaries, so they may run slightly long
+    if (interval_insns >= interval)
+      dump();
+  }
+}
+
+void bbv_t::dump()
+{
+  fputc('T', file);
+  for (block_t* b : touched)
+  {
+    fprintf(file, ":%zu:%" PRIu64 " ", b->id, b->insns);
+    b->insns = 0;
+  }
+  fputc('\n', file);
+  touched.clear();
+  interval_insns = 0;
+}
@@ -0,0 +1,58 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_BBV_H
+#define _RISCV_BBV_H
+
+#include "decode.h"
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+// writes a basic-block vector for every interval of retired instructions,
+// in the .bb format that SimPoint reads: one line per interval of the form
+//  T:<block id>:<instructions> :<block id>:<instructions> ...
+// where block ids count from 1 in order of first execution.
+class bbv_t
+{
+ public:
+  bbv_t(const char* filename, uint64_t interval);
+  ~bbv_t();
+
+  // account for a retired instruction at pc whose successor is npc
+  void retire(reg_t pc, reg_t npc, int length)
+  {
+    retire_chain(pc, 1, npc != pc + length);
+  }
+  // account for insns instructions retired in sequence from pc, as the
+  // stepping loop's chains of decoded instructions are; taken if the last
+  // one's successor isn't the next instruction
+  void retire_chain(reg_t pc, uint64_t insns, bool taken)
+  {
+    if (block_insns == 0)
+      block_start = pc;
+    block_insns += insns;
+    if (taken)
+      end_block();
+  }
+  // end the current block, e.g. because of a trap
+  void end_block();
+
+ private:
+  struct block_t
+  {
+    size_t id;
+    uint64_t insns; // in this interval
+  };
+
+  FILE* file;
+  uint64_t interval;
+  uint64_t interval_insns;
+  reg_t block_start;
+  uint64_t block_insns;
+  std::unordered_map<reg_t, block_t> blocks;
+  std::vector<block_t*> touched; // blocks executed in this interval
+
+  void dump();
+};
+
+#endif
@@ -0,0 +1,76 @@
+// See LICENSE for license details.
+
+#include "blkdev.h"
+#include "mmu.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+
+blkdev_t::blkdev_t(const char* filename)
+  : local_device_t({"read", "write"}), filename(filename)
+{
+  fd = open(filename, O_RDWR);
+  struct stat s;
+  if (fd < 0 || fstat(fd, &s) < 0)
+  {
+    fprintf(stderr, "couldn't open block device image %s\n", filename);
+    exit(1);
+  }
+
+  size = s.st_size;
+  if (size == 0)
+  {
+    fprintf(stderr, "block device image %s is empty\n", filename);
+    exit(1);
+  }
+  image = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (image == MAP_FAILED)
+  {
+    fprintf(stderr, "couldn't map block device image %s\n", filename);
+    exit(1);
+  }
+
+  identity = "disk size=" + std::to_string(size);
+}
+
+blkdev_t::~blkdev_t()
+{
+  munmap(image, size);
+  close(fd);
+}
+
+void blkdev_t::detach()
+{
+  // keep writes in this process
+  if (mmap(image, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+  {
+    fprintf(stderr, "couldn't map block device image %s\n", filename);
+    exit(1);
+  }
+}
+
+bool blkdev_t::command(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp)
+{
+  *resp = ERROR;
+  if (cmd > 1)
+    return true;
+
+  request_t req;
+  if (!mmu->in_memory(payload, sizeof(req)))
+    return true;
+  mmu->load_bytes(payload, sizeof(req), &req);
+  if (req.offset > size || req.size > size - req.offset ||
+      !mmu->in_memory(req.addr, req.size))
+    return true;
+
+  if (cmd == 0)
+    mmu->store_bytes(req.addr, req.size, image + req.offset);
+  else
+    mmu->load_bytes(req.addr, req.size, image + req.offset);
+
+  *resp = req.tag;
+  return true;
+}
@@ -0,0 +1,41 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_BLKDEV_H
+#define _RISCV_BLKDEV_H
+
+#include "localdev.h"
+
+// a block device backed by a host image file, which is mapped into the
+// simulator so that transfers are copies between it and guest memory.
+// it speaks the frontend's disk protocol: the payload of a read (command
+// 0) or write (1) is the address of a request, and the response is its tag.
+// a request that doesn't fit in the image or in guest memory, or an
+// unknown command, gets the response ERROR instead.
+class blkdev_t : public local_device_t
+{
+ public:
+  static const uint8_t DEVICE = 16; // its number on the HTIF
+
+  blkdev_t(const char* filename);
+  ~blkdev_t();
+  void detach();
+
+ protected:
+  bool command(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp);
+
+ private:
+  struct request_t
+  {
+    uint64_t addr; // in guest memory
+    uint64_t offset; // in the image
+    uint64_t size;
+    uint64_t tag;
+  };
+
+  const char* filename;
+  int fd;
+  char* image;
+  size_t size;
+};
+
+#endif
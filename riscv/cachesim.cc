@@ -2,9 +2,13 @@
 
 #include "cachesim.h"
 #include "common.h"
+#include "symtab.h"
+#include "stats.h"
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
 
 cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name)
  : sets(_sets), ways(_ways), linesz(_linesz), name(_name)
@@ -56,22 +60,64 @@ void cache_sim_t::init()
   write_misses = 0;
   bytes_written = 0;
   writebacks = 0;
+  prefetch_requests = 0;
+  prefetch_request_misses = 0;
+  prefetches_issued = 0;
+  prefetches_useful = 0;
+  prefetches_late = 0;
+  prefetch_lead = 0;
+  hit_latency = 0;
+  memory_latency = 0;
+  now = 0;
+  warming = false;
 
   miss_handler = NULL;
+  prefetcher = NULL;
+  attribution_top_n = 0;
+  symbols = NULL;
+  by_symbol = false;
 }
 
+// the copy has rhs's configuration and contents, but fresh statistics and
+// no prefetcher (which rhs owns) or miss handler
 cache_sim_t::cache_sim_t(const cache_sim_t& rhs)
- : sets(rhs.sets), ways(rhs.ways), linesz(rhs.linesz),
-   idx_shift(rhs.idx_shift), name(rhs.name)
+ : sets(rhs.sets), ways(rhs.ways), linesz(rhs.linesz), name(rhs.name)
 {
-  tags = new uint64_t[sets*ways];
+  init();
   memcpy(tags, rhs.tags, sets*ways*sizeof(uint64_t));
+  set_latency(rhs.hit_latency, rhs.memory_latency);
+  set_attribution(rhs.attribution_top_n, rhs.symbols, rhs.by_symbol);
+  warming = rhs.warming;
 }
 
 cache_sim_t::~cache_sim_t()
 {
   print_stats();
   delete [] tags;
+  delete prefetcher;
+}
+
+void cache_sim_t::set_prefetcher(prefetcher_t* pf)
+{
+  delete prefetcher;
+  prefetcher = pf;
+}
+
+void cache_sim_t::set_attribution(size_t top_n, const symtab_t* syms, bool by_sym)
+{
+  attribution_top_n = top_n;
+  symbols = syms;
+  by_symbol = by_sym && syms;
+}
+
+uint64_t cache_sim_t::region(uint64_t vaddr)
+{
+  if (vaddr == UNTRANSLATED)
+    return UNTRANSLATED;
+  if (!by_symbol)
+    return vaddr >> 12 << 12;
+  const symbol_t* s = symbols->lookup(vaddr);
+  return s ? s->addr : UNTRANSLATED;
 }
 
 void cache_sim_t::print_stats()
@@ -96,8 +142,96 @@ void cache_sim_t::print_stats()
   std::cout << "Write Misses:          " << write_misses << std::endl;
   std::cout << name << " ";
   std::cout << "Writebacks:            " << writebacks << std::endl;
+  if (prefetch_requests)
+  {
+    std::cout << name << " ";
+    std::cout << "Prefetch Requests:     " << prefetch_requests << std::endl;
+    std::cout << name << " ";
+    std::cout << "Prefetch Req Misses:   " << prefetch_request_misses << std::endl;
+  }
   std::cout << name << " ";
   std::cout << "Miss Rate:             " << mr << '%' << std::endl;
+
+  if (prefetcher)
+    print_prefetch_stats();
+  if (attribution_top_n)
+    print_attribution();
+}
+
+void cache_sim_t::register_stats(stats_t* stats)
+{
+  stats->add(name + ".bytes_read", &bytes_read);
+  stats->add(name + ".bytes_written", &bytes_written);
+  stats->add(name + ".read_accesses", &read_accesses);
+  stats->add(name + ".write_accesses", &write_accesses);
+  stats->add(name + ".read_misses", &read_misses);
+  stats->add(name + ".write_misses", &write_misses);
+  stats->add(name + ".writebacks", &writebacks);
+  stats->add(name + ".prefetch_requests", &prefetch_requests);
+  stats->add(name + ".prefetch_request_misses", &prefetch_request_misses);
+  if (prefetcher)
+  {
+    stats->add(name + ".prefetches_issued", &prefetches_issued);
+    stats->add(name + ".prefetches_useful", &prefetches_useful);
+    stats->add(name + ".prefetches_late", &prefetches_late);
+  }
+}
+
+void cache_sim_t::print_prefetch_stats()
+{
+  uint64_t misses = read_misses + write_misses;
+  float accuracy = prefetches_issued ? 100.0f*prefetches_useful/prefetches_issued : 0;
+  float coverage = prefetches_useful ? 100.0f*prefetches_useful/(prefetches_useful+misses) : 0;
+  float lead = prefetches_useful ? float(prefetch_lead)/prefetches_useful : 0;
+
+  std::cout << name << " ";
+  std::cout << "Prefetcher:            " << prefetcher->name() << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetches Issued:     " << prefetches_issued << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetches Useful:     " << prefetches_useful << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetches Late:       " << prefetches_late << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetch Accuracy:     " << accuracy << '%' << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetch Coverage:     " << coverage << '%' << std::endl;
+  std::cout << name << " ";
+  std::cout << "Prefetch Avg Lead:     " << lead << " accesses" << std::endl;
+}
+
+void cache_sim_t::print_attribution()
+{
+  uint64_t misses = read_misses + write_misses;
+  auto report = [&](const char* title, const std::unordered_map<uint64_t, miss_count_t>& counts, bool pcs)
+  {
+    std::vector<std::pair<uint64_t, miss_count_t>> v(counts.begin(), counts.end());
+    size_t n = std::min(attribution_top_n, v.size());
+    std::partial_sort(v.begin(), v.begin() + n, v.end(),
+      [](const std::pair<uint64_t, miss_count_t>& a, const std::pair<uint64_t, miss_count_t>& b) {
+        return a.second.misses + a.second.writebacks > b.second.misses + b.second.writebacks;
+      });
+
+    std::cout << name << " " << title << std::endl;
+    for (size_t i = 0; i < n; i++)
+    {
+      uint64_t key = v[i].first;
+      std::string where = pcs ? (symbols ? symbols->describe(key) : "") :
+                          key == UNTRANSLATED ? "(unknown)" :
+                          by_symbol ? symbols->describe(key) : "page";
+
+      std::cout << name << "   ";
+      std::cout << "0x" << std::hex << std::setw(16) << std::setfill('0') << key;
+      std::cout << std::dec << std::setfill(' ') << " ";
+      std::cout << std::left << std::setw(28) << where << std::right;
+      std::cout << " misses " << std::setw(12) << v[i].second.misses;
+      std::cout << " (" << std::setw(6) << (misses ? 100.0f*v[i].second.misses/misses : 0) << "%)";
+      std::cout << " writebacks " << v[i].second.writebacks << std::endl;
+    }
+  };
+
+  report("Top Miss PCs:", pc_misses, true);
+  report("Top Miss Regions:", region_misses, false);
 }
 
 uint64_t* cache_sim_t::check_tag(uint64_t addr)
@@ -106,7 +240,7 @@ uint64_t* cache_sim_t::check_tag(uint64_t addr)
   size_t tag = (addr >> idx_shift) | VALID;
 
   for (size_t i = 0; i < ways; i++)
-    if (tag == (tags[idx*ways + i] & ~DIRTY))
+    if (tag == (tags[idx*ways + i] & ~(DIRTY | PREFETCHED)))
       return &tags[idx*ways + i];
 
   return NULL;
@@ -121,36 +255,146 @@ uint64_t cache_sim_t::victimize(uint64_t addr)
   return victim;
 }
 
-void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
+uint64_t cache_sim_t::access(uint64_t addr, size_t bytes, bool store, uint64_t pc, uint64_t vaddr,
+                             bool demand)
 {
-  store ? write_accesses++ : read_accesses++;
-  (store ? bytes_written : bytes_read) += bytes;
+  uint64_t latency = hit_latency;
+  if (unlikely(!demand))
+  {
+    if (likely(!warming))
+      prefetch_requests++;
+    if (check_tag(addr))
+      return latency;
+    if (likely(!warming))
+      prefetch_request_misses++;
+    return latency + fill(addr, pc, vaddr, false);
+  }
+
+  now++;
+  if (likely(!warming))
+  {
+    store ? write_accesses++ : read_accesses++;
+    (store ? bytes_written : bytes_read) += bytes;
+  }
 
   uint64_t* hit_way = check_tag(addr);
   if (likely(hit_way != NULL))
   {
+    if (unlikely(*hit_way & PREFETCHED))
+      prefetch_hit(hit_way, addr);
     if (store)
       *hit_way |= DIRTY;
-    return;
   }
+  else
+  {
+    if (likely(!warming))
+    {
+      store ? write_misses++ : read_misses++;
+      if (attribution_top_n)
+      {
+        pc_misses[pc].misses++;
+        region_misses[region(vaddr)].misses++;
+      }
+    }
+
+    latency += fill(addr, pc, vaddr, true);
 
-  store ? write_misses++ : read_misses++;
+    if (store)
+      *check_tag(addr) |= DIRTY;
+  }
+
+  if (prefetcher)
+    prefetch(addr, pc, vaddr, hit_way == NULL);
+
+  return latency;
+}
 
+uint64_t cache_sim_t::fill(uint64_t addr, uint64_t pc, uint64_t vaddr, bool demand)
+{
   uint64_t victim = victimize(addr);
 
+  if (unlikely(victim & PREFETCHED)) // evicted before it was ever used
+    prefetch_time.erase(victim & ~FLAGS);
+
+  // the victim's vaddr, remembered when it was filled, so its writeback
+  // can be attributed to a region
+  uint64_t victim_vaddr = UNTRANSLATED;
+  if (unlikely(attribution_top_n))
+  {
+    auto it = line_vaddrs.find(victim & ~FLAGS);
+    if ((victim & VALID) && it != line_vaddrs.end())
+    {
+      victim_vaddr = it->second;
+      line_vaddrs.erase(it);
+    }
+    if (vaddr != UNTRANSLATED)
+      line_vaddrs[addr >> idx_shift] = vaddr & ~(linesz-1);
+  }
+
   if ((victim & (VALID | DIRTY)) == (VALID | DIRTY))
   {
-    uint64_t dirty_addr = (victim & ~(VALID | DIRTY)) << idx_shift;
+    uint64_t dirty_addr = (victim & ~FLAGS) << idx_shift;
     if (miss_handler)
-      miss_handler->access(dirty_addr, linesz, true);
-    writebacks++;
+      miss_handler->access(dirty_addr, linesz, true, pc, victim_vaddr);
+    if (likely(!warming))
+    {
+      writebacks++;
+      if (attribution_top_n)
+      {
+        pc_misses[pc].writebacks++;
+        region_misses[region(victim_vaddr)].writebacks++;
+      }
+    }
   }
 
+  // writebacks are assumed to be buffered, so only the refill is exposed
+  uint64_t line_vaddr = vaddr == UNTRANSLATED ? vaddr : vaddr & ~(linesz-1);
   if (miss_handler)
-    miss_handler->access(addr & ~(linesz-1), linesz, false);
+    return miss_handler->access(addr & ~(linesz-1), linesz, false, pc, line_vaddr, demand);
+  return memory_latency;
+}
+
+void cache_sim_t::prefetch(uint64_t addr, uint64_t pc, uint64_t vaddr, bool miss)
+{
+  prefetch_lines.clear();
+  prefetcher->observe(addr >> idx_shift, pc, miss, prefetch_lines);
+
+  for (uint64_t line : prefetch_lines)
+  {
+    uint64_t line_addr = line << idx_shift;
+    if (check_tag(line_addr))
+      continue;
+
+    // a line on the triggering access's page is as far from it virtually
+    // as physically; elsewhere, its vaddr is unknown
+    uint64_t line_vaddr = UNTRANSLATED;
+    if (vaddr != UNTRANSLATED && line_addr >> 12 == addr >> 12)
+      line_vaddr = vaddr + (line_addr - addr);
+
+    if (likely(!warming))
+      prefetches_issued++;
+    fill(line_addr, pc, line_vaddr, false);
+    *check_tag(line_addr) |= PREFETCHED;
+    prefetch_time[line] = now;
+  }
+}
 
-  if (store)
-    *check_tag(addr) |= DIRTY;
+void cache_sim_t::prefetch_hit(uint64_t* way, uint64_t addr)
+{
+  *way &= ~PREFETCHED;
+
+  auto it = prefetch_time.find(addr >> idx_shift);
+  uint64_t lead = it == prefetch_time.end() ? 0 : now - it->second;
+  if (it != prefetch_time.end())
+    prefetch_time.erase(it);
+
+  if (likely(!warming))
+  {
+    prefetches_useful++;
+    prefetch_lead += lead;
+    if (lead <= PREFETCH_LATE_DISTANCE)
+      prefetches_late++;
+  }
 }
 
 fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name)
@@ -177,3 +421,114 @@ uint64_t fa_cache_sim_t::victimize(uint64_t addr)
   tags[addr >> idx_shift] = (addr >> idx_shift) | VALID;
   return old_tag;
 }
+
+static void sampler_help()
+{
+  std::cerr << "Cache sampling configurations must be of the form" << std::endl;
+  std::cerr << "  fastforward:warmup:measure" << std::endl;
+  std::cerr << "where each field is an instruction count, and measure is positive." << std::endl;
+  exit(1);
+}
+
+cache_sampler_t::cache_sampler_t(const char* config)
+{
+  const char* wp = strchr(config, ':');
+  if (!wp++) sampler_help();
+  const char* mp = strchr(wp, ':');
+  if (!mp++) sampler_help();
+
+  length[FAST_FORWARD] = strtoull(std::string(config, wp).c_str(), NULL, 0);
+  length[WARMUP] = strtoull(std::string(wp, mp).c_str(), NULL, 0);
+  length[MEASURE] = strtoull(mp, NULL, 0);
+  if (length[MEASURE] == 0)
+    sampler_help();
+
+  phase = FAST_FORWARD;
+  enter(FAST_FORWARD);
+}
+
+cache_sampler_t::~cache_sampler_t()
+{
+  // the run may end partway through a window
+  if (phase == MEASURE)
+    end_window();
+  print_stats();
+}
+
+void cache_sampler_t::add_cache(cache_sim_t* c)
+{
+  samples.push_back((sample_t){c, 0, 0});
+  c->set_warming(phase != MEASURE);
+}
+
+void cache_sampler_t::enter(phase_t p)
+{
+  // skip over empty phases
+  while (length[p] == 0)
+    p = phase_t((p + 1) % NPHASES);
+
+  // with no fast-forward or warmup, one window follows another
+  if (phase == MEASURE)
+    end_window();
+
+  if (p == MEASURE)
+  {
+    for (auto& s : samples)
+    {
+      s.accesses = s.cache->read_accesses + s.cache->write_accesses;
+      s.misses = s.cache->read_misses + s.cache->write_misses;
+    }
+  }
+
+  for (auto& s : samples)
+    s.cache->set_warming(p != MEASURE);
+
+  phase = p;
+  left = length[p];
+}
+
+void cache_sampler_t::end_window()
+{
+  for (auto& s : samples)
+  {
+    uint64_t accesses = s.cache->read_accesses + s.cache->write_accesses;
+    uint64_t misses = s.cache->read_misses + s.cache->write_misses;
+    if (accesses != s.accesses)
+      s.miss_rates.push_back(double(misses - s.misses) / (accesses - s.accesses));
+  }
+}
+
+bool cache_sampler_t::advance(size_t n)
+{
+  bool was_tracing = tracing();
+  while (n >= left)
+  {
+    n -= left;
+    enter(phase_t((phase + 1) % NPHASES));
+  }
+  left -= n;
+  return tracing() != was_tracing;
+}
+
+void cache_sampler_t::print_stats()
+{
+  std::cout << std::setprecision(3) << std::fixed;
+  for (auto& s : samples)
+  {
+    size_t n = s.miss_rates.size();
+    if (n == 0)
+      continue;
+
+    double sum = 0, sumsq = 0;
+    for (double r : s.miss_rates)
+      sum += r, sumsq += r*r;
+    double mean = sum / n;
+    double var = n > 1 ? (sumsq - n*mean*mean) / (n-1) : 0;
+    double ci = 1.96 * sqrt(std::max(var, 0.0) / n); // 95% confidence
+
+    std::cout << s.cache->name << " ";
+    std::cout << "Samples:               " << n << std::endl;
+    std::cout << s.cache->name << " ";
+    std::cout << "Sampled Miss Rate:     " << 100*mean << "% +/- " << 100*ci << '%' << std::endl;
+  }
+}
@@ -4,11 +4,17 @@
 #define _RISCV_CACHE_SIM_H
 
 #include "memtracer.h"
+#include "prefetcher.h"
 #include <cstring>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <cstdint>
 
+class symtab_t;
+class stats_t;
+
 class lfsr_t
 {
  public:
@@ -26,21 +32,56 @@ class cache_sim_t
   cache_sim_t(const cache_sim_t& rhs);
   virtual ~cache_sim_t();
 
-  void access(uint64_t addr, size_t bytes, bool store);
+  static const uint64_t UNTRANSLATED = -1; // a vaddr for page table accesses
+
+  // returns the access latency in cycles. addr is physical; vaddr, where
+  // it was accessed, is only used to attribute misses. an access that
+  // isn't a demand is a prefetch fill from the level above: it's counted
+  // apart, and neither attributed nor trained on.
+  uint64_t access(uint64_t addr, size_t bytes, bool store, uint64_t pc, uint64_t vaddr = UNTRANSLATED,
+                  bool demand = true);
   void print_stats();
+  void register_stats(stats_t* stats);
   void set_miss_handler(cache_sim_t* mh) { miss_handler = mh; }
+  void set_prefetcher(prefetcher_t* pf); // the cache takes ownership
+  // a hit costs hit_latency cycles; a miss additionally costs the latency
+  // of the miss handler or, in the last level, memory_latency cycles
+  void set_latency(unsigned hit, unsigned memory) { hit_latency = hit; memory_latency = memory; }
+
+  // attribute misses and writebacks to PCs and to data regions, which are
+  // virtual pages or, if by_symbol, the symbols containing the address.
+  // print_stats reports the top_n of each, naming PCs by symbols if given.
+  void set_attribution(size_t top_n, const symtab_t* symbols, bool by_symbol);
+  void set_warming(bool value) { warming = value; }
+
+  uint64_t get_accesses() { return read_accesses + write_accesses; }
+  uint64_t get_misses() { return read_misses + write_misses; }
 
   static cache_sim_t* construct(const char* config, const char* name);
 
  protected:
   static const uint64_t VALID = 1ULL << 63;
   static const uint64_t DIRTY = 1ULL << 62;
+  static const uint64_t PREFETCHED = 1ULL << 61; // not yet demanded
+  static const uint64_t FLAGS = VALID | DIRTY | PREFETCHED;
+
+  // prefetches used within this many accesses of being issued are late
+  static const uint64_t PREFETCH_LATE_DISTANCE = 4;
 
   virtual uint64_t* check_tag(uint64_t addr);
   virtual uint64_t victimize(uint64_t addr);
 
+  uint64_t fill(uint64_t addr, uint64_t pc, uint64_t vaddr, bool demand);
+  void prefetch(uint64_t addr, uint64_t pc, uint64_t vaddr, bool miss);
+  void prefetch_hit(uint64_t* way, uint64_t addr);
+
+  void print_prefetch_stats();
+  void print_attribution();
+  uint64_t region(uint64_t addr);
+
   lfsr_t lfsr;
   cache_sim_t* miss_handler;
+  prefetcher_t* prefetcher;
 
   size_t sets;
   size_t ways;
@@ -56,10 +97,40 @@ class cache_sim_t
   uint64_t write_misses;
   uint64_t bytes_written;
   uint64_t writebacks;
+  uint64_t prefetch_requests; // fills for the level above's prefetches
+  uint64_t prefetch_request_misses;
+
+  uint64_t prefetches_issued;
+  uint64_t prefetches_useful;
+  uint64_t prefetches_late;
+  uint64_t prefetch_lead; // sum over useful prefetches of accesses until use
+
+  unsigned hit_latency;
+  unsigned memory_latency;
+
+  uint64_t now; // demand accesses seen, including while warming
+  std::unordered_map<uint64_t, uint64_t> prefetch_time; // line -> issue time
+  std::vector<uint64_t> prefetch_lines;
+
+  struct miss_count_t
+  {
+    uint64_t misses;
+    uint64_t writebacks;
+  };
+  size_t attribution_top_n; // zero if attribution is disabled
+  const symtab_t* symbols;
+  bool by_symbol;
+  std::unordered_map<uint64_t, uint64_t> line_vaddrs; // line -> its vaddr
+  std::unordered_map<uint64_t, miss_count_t> pc_misses;
+  std::unordered_map<uint64_t, miss_count_t> region_misses;
+
+  bool warming; // update tags, but don't count statistics
 
   std::string name;
 
   void init();
+
+  friend class cache_sampler_t;
 };
 
 class fa_cache_sim_t : public cache_sim_t
@@ -77,6 +148,7 @@ class cache_memtracer_t : public memtracer_t
 {
  public:
   cache_memtracer_t(const char* config, const char* name)
+    : stall_cycles(0)
   {
     cache = cache_sim_t::construct(config, name);
   }
@@ -88,9 +160,12 @@ class cache_memtracer_t : public memtracer_t
   {
     cache->set_miss_handler(mh);
   }
+  cache_sim_t* get_cache() { return cache; }
+  uint64_t get_stall_cycles() { return stall_cycles; }
 
  protected:
   cache_sim_t* cache;
+  uint64_t stall_cycles; // total latency of the traced accesses
 };
 
 class icache_sim_t : public cache_memtracer_t
@@ -101,9 +176,9 @@ class icache_sim_t : public cache_memtracer_t
   {
     return fetch;
   }
-  void trace(uint64_t addr, size_t bytes, bool store, bool fetch)
+  void trace(uint64_t addr, size_t bytes, bool store, bool fetch, uint64_t vaddr, uint64_t pc)
   {
-    if (fetch) cache->access(addr, bytes, false);
+    if (fetch) stall_cycles += cache->access(addr, bytes, false, pc, vaddr);
   }
 };
 
@@ -115,10 +190,48 @@ class dcache_sim_t : public cache_memtracer_t
   {
     return !fetch;
   }
-  void trace(uint64_t addr, size_t bytes, bool store, bool fetch)
+  void trace(uint64_t addr, size_t bytes, bool store, bool fetch, uint64_t vaddr, uint64_t pc)
   {
-    if (!fetch) cache->access(addr, bytes, store);
+    if (!fetch) stall_cycles += cache->access(addr, bytes, store, pc, vaddr);
   }
 };
 
+// alternates between fast-forwarding with tracing detached, functionally
+// warming the caches, and measuring them, reporting the per-window miss
+// rates of each cache with a confidence interval.
+class cache_sampler_t
+{
+ public:
+  cache_sampler_t(const char* config);
+  ~cache_sampler_t();
+
+  void add_cache(cache_sim_t* c);
+  void print_stats();
+
+  // account for n retired instructions; returns true if tracing toggled
+  bool advance(size_t n);
+  // instructions left before the next phase change
+  size_t remaining() { return left; }
+  bool tracing() { return phase != FAST_FORWARD; }
+
+ private:
+  enum phase_t { FAST_FORWARD, WARMUP, MEASURE, NPHASES };
+
+  struct sample_t
+  {
+    cache_sim_t* cache;
+    uint64_t accesses;
+    uint64_t misses;
+    std::vector<double> miss_rates;
+  };
+
+  size_t length[NPHASES];
+  phase_t phase;
+  size_t left;
+  std::vector<sample_t> samples;
+
+  void enter(phase_t p);
+  void end_window(); // of MEASURE: record each cache's miss rate over it
+};
+
 #endif
@@ -0,0 +1,201 @@
+// See LICENSE for license details.
+
+#include "checkpoint.h"
+#include "sim.h"
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void write_failed()
+{
+  fprintf(stderr, "couldn't write checkpoint\n");
+  exit(1);
+}
+
+void checkpoint_write(FILE* f, const void* p, size_t n)
+{
+  if (fwrite(p, 1, n, f) != n)
+    write_failed();
+}
+
+void checkpoint_read(FILE* f, void* p, size_t n)
+{
+  if (fread(p, 1, n, f) != n)
+  {
+    fprintf(stderr, "checkpoint is truncated\n");
+    exit(1);
+  }
+}
+
+static off_t memory_offset(FILE* f)
+{
+  return (ftello(f) + CHECKPOINT_MEM_ALIGN - 1) & -off_t(CHECKPOINT_MEM_ALIGN);
+}
+
+static bool zero_page(const char* page)
+{
+  const uint64_t* p = (const uint64_t*)page;
+  for (size_t i = 0; i < PGSIZE / sizeof(*p); i++)
+    if (p[i])
+      return false;
+  return true;
+}
+
+static std::string directory_of(const std::string& filename)
+{
+  size_t slash = filename.rfind('/');
+  return slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+}
+
+void sim_t::save_checkpoint(const char* filename, const char* parent)
+{
+  // memory may be mapped from a checkpoint of the same name, which must be
+  // left intact rather than truncated
+  unlink(filename);
+  FILE* f = fopen(filename, "wb");
+  if (!f)
+  {
+    fprintf(stderr, "couldn't open checkpoint file %s\n", filename);
+    exit(1);
+  }
+
+  if (parent)
+  {
+    std::string name = std::string(parent).substr(directory_of(parent).size());
+    uint64_t name_len = name.size();
+    checkpoint_write(f, CHECKPOINT_INCREMENTAL_MAGIC, strlen(CHECKPOINT_INCREMENTAL_MAGIC));
+    checkpoint_write(f, &name_len, sizeof(name_len));
+    checkpoint_write(f, name.data(), name.size());
+  }
+  else
+    checkpoint_write(f, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC));
+
+  uint64_t config[2] = {procs.size(), memsz};
+  checkpoint_write(f, config, sizeof(config));
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->save_state(f);
+  uint64_t system[3] = {rtc, current_step, current_proc};
+  checkpoint_write(f, system, sizeof(system));
+
+  if (parent)
+  {
+    std::vector<uint64_t> pages;
+    for (size_t page = 0; page < memsz / PGSIZE; page++)
+      if (dirty_pages->dirty(page))
+        pages.push_back(page);
+
+    uint64_t npages = pages.size();
+    checkpoint_write(f, &npages, sizeof(npages));
+    checkpoint_write(f, pages.data(), npages * sizeof(uint64_t));
+    if (fseeko(f, memory_offset(f), SEEK_SET) != 0)
+      write_failed();
+    for (size_t i = 0; i < npages; i++)
+      checkpoint_write(f, mem + pages[i] * PGSIZE, PGSIZE);
+    fclose(f);
+    return;
+  }
+
+  off_t base = memory_offset(f);
+  bool seek = true;
+  for (size_t offset = 0; offset < memsz; offset += PGSIZE)
+  {
+    if (zero_page(mem + offset))
+      seek = true;
+    else
+    {
+      if (seek && fseeko(f, base + offset, SEEK_SET) != 0)
+        write_failed();
+      seek = false;
+      checkpoint_write(f, mem + offset, PGSIZE);
+    }
+  }
+
+  if (fflush(f) != 0 || ftruncate(fileno(f), base + memsz) != 0)
+    write_failed();
+  fclose(f);
+}
+
+void sim_t::restore_checkpoint(const char* filename)
+{
+  FILE* f = fopen(filename, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "couldn't open checkpoint file %s\n", filename);
+    exit(1);
+  }
+
+  char magic[sizeof(CHECKPOINT_MAGIC) - 1];
+  checkpoint_read(f, magic, sizeof(magic));
+  bool incremental = memcmp(magic, CHECKPOINT_INCREMENTAL_MAGIC, sizeof(magic)) == 0;
+  if (!incremental && memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+  {
+    fprintf(stderr, "%s is not a checkpoint\n", filename);
+    exit(1);
+  }
+
+  // restore what this one builds on, then apply it on top
+  if (incremental)
+  {
+    uint64_t name_len;
+    checkpoint_read(f, &name_len, sizeof(name_len));
+    std::string name(std::min(name_len, uint64_t(PATH_MAX)), 0);
+    checkpoint_read(f, &name[0], name.size());
+    restore_checkpoint((directory_of(filename) + name).c_str());
+  }
+
+  uint64_t config[2];
+  checkpoint_read(f, config, sizeof(config));
+  if (config[0] != procs.size() || config[1] != memsz)
+  {
+    fprintf(stderr, "checkpoint %s needs -p%d -m%d\n", filename,
+            int(config[0]), int(config[1] >> 20));
+    exit(1);
+  }
+
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->restore_state(f);
+  uint64_t system[3];
+  checkpoint_read(f, system, sizeof(system));
+  rtc = system[0];
+  current_step = system[1];
+  current_proc = system[2];
+
+  if (incremental)
+  {
+    uint64_t npages;
+    checkpoint_read(f, &npages, sizeof(npages));
+    std::vector<uint64_t> pages(npages);
+    checkpoint_read(f, pages.data(), npages * sizeof(uint64_t));
+    if (fseeko(f, memory_offset(f), SEEK_SET) != 0)
+    {
+      fprintf(stderr, "checkpoint %s is truncated\n", filename);
+      exit(1);
+    }
+    for (size_t i = 0; i < npages; i++)
+    {
+      if (pages[i] >= memsz / PGSIZE)
+      {
+        fprintf(stderr, "checkpoint %s is corrupt\n", filename);
+        exit(1);
+      }
+      checkpoint_read(f, mem + pages[i] * PGSIZE, PGSIZE);
+    }
+    fclose(f);
+    return;
+  }
+
+  // map memory copy-on-write, so pages are only read in when touched and
+  // the holes left for zero pages cost nothing
+  void* p = mmap(mem, memsz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                 fileno(f), memory_offset(f));
+  if (p == MAP_FAILED)
+  {
+    fprintf(stderr, "couldn't map the memory of checkpoint %s\n", filename);
+    exit(1);
+  }
+  fclose(f);
+}
@@ -0,0 +1,33 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_CHECKPOINT_H
+#define _RISCV_CHECKPOINT_H
+
+#include <cstdio>
+#include <cstddef>
+
+// a checkpoint file holds the magic number, the machine's configuration,
+// the state of each hart (its state_t, which is only readable by a build
+// with the same sizeof(state_t), and the host responses queued for it) and
+// of its extension, and the system's own state,
+// followed by guest memory at a CHECKPOINT_MEM_ALIGN-aligned offset, so
+// that it can be mapped in directly. zero pages of memory are left as
+// holes in the file.
+//
+// an incremental checkpoint has its own magic number, which is followed
+// by the name of the checkpoint it builds on, relative to its directory.
+// in place of all of memory, it holds the number of pages written to
+// since that checkpoint, their page numbers, and then, at an aligned
+// offset, their contents.
+//
+// local devices aren't saved, so none may be waiting to respond to a
+// request. a request the frontend has taken but not answered is lost too.
+#define CHECKPOINT_MAGIC "SPKCKP02"
+#define CHECKPOINT_INCREMENTAL_MAGIC "SPKCKI02"
+#define CHECKPOINT_MEM_ALIGN (1 << 16)
+
+// read or write n bytes of a checkpoint, exiting on failure
+void checkpoint_write(FILE* f, const void* p, size_t n);
+void checkpoint_read(FILE* f, void* p, size_t n);
+
+#endif
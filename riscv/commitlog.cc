@@ -0,0 +1,95 @@
+// See LICENSE for license details.
+
+#include "commitlog.h"
+#include <algorithm>
+#include <cstdlib>
+
+void commit_log_header_t::decode(const uint8_t* p)
+{
+  flags = p[0];
+  rd = p[1];
+  hart = commit_log_get(p + 2, 2);
+  pc = commit_log_get(p + 4, 8);
+}
+
+std::vector<commit_log_t*> commit_log_t::logs;
+
+commit_log_t::commit_log_t(const char* filename)
+{
+  open(filename);
+  if (logs.empty())
+    atexit(flush_all);
+  logs.push_back(this);
+}
+
+void commit_log_t::reopen(const char* filename)
+{
+  fclose(file);
+  open(filename);
+}
+
+void commit_log_t::open(const char* filename)
+{
+  file = fopen(filename, "wb");
+  if (!file)
+  {
+    fprintf(stderr, "couldn't open commit log %s\n", filename);
+    exit(1);
+  }
+  len = 0;
+  for (const char* p = COMMIT_LOG_MAGIC; *p; p++)
+    put(*p, 1);
+}
+
+commit_log_t::~commit_log_t()
+{
+  logs.erase(std::find(logs.begin(), logs.end(), this));
+  flush();
+  fclose(file);
+}
+
+bool commit_log_t::write()
+{
+  bool ok = fwrite(buf, 1, len, file) == len;
+  len = 0;
+  return ok;
+}
+
+void commit_log_t::flush()
+{
+  if (!write())
+  {
+    fprintf(stderr, "error writing the commit log\n");
+    exit(1);
+  }
+}
+
+// exit() closes the files, but doesn't know about our buffers
+void commit_log_t::flush_all()
+{
+  for (auto log : logs)
+    if (!log->write())
+      fprintf(stderr, "error writing the commit log\n");
+}
+
+void commit_log_t::log(uint32_t hart, reg_t pc, insn_t insn, const commit_log_reg_t& rd, const reg_t* addr)
+{
+  if (unlikely(len + MAX_RECORD > BUFFER_SIZE))
+    flush();
+
+  int length = insn.length();
+  uint8_t flags = (length == 2 ? COMMIT_LOG_INSN16 : length > 4 ? COMMIT_LOG_INSN64 : 0)
+                | (rd.addr ? COMMIT_LOG_RD : 0) | (rd.addr & 1 ? COMMIT_LOG_FRD : 0)
+                | (addr ? COMMIT_LOG_ADDR : 0);
+  put(flags, 1);
+  put(rd.addr >> 1, 1);
+  put(hart, 2);
+  put(pc, 8);
+
+  // 6-byte instructions are logged as 8 bytes
+  put(insn.bits(), length == 2 ? 2 : length == 4 ? 4 : 8);
+  if (rd.addr)
+    put(rd.data, 8);
+  if (addr)
+    put(*addr, 8);
+}
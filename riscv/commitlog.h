@@ -0,0 +1,80 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_COMMIT_LOG_H
+#define _RISCV_COMMIT_LOG_H
+
+#include "processor.h"
+#include <cstdio>
+#include <vector>
+
+// the log starts with COMMIT_LOG_MAGIC. each retired instruction is then
+// a COMMIT_LOG_HEADER_SIZE-byte header (flags, rd, hart, and pc, in that
+// order), followed by the instruction bits (2, 4, or 8 bytes), the value
+// written to rd if COMMIT_LOG_RD is set, and the virtual address accessed
+// if COMMIT_LOG_ADDR is set. all fields are little-endian. a register
+// write is only seen if it changed the register's value.
+#define COMMIT_LOG_MAGIC "SPKLOG01"
+#define COMMIT_LOG_HEADER_SIZE 12
+
+#define COMMIT_LOG_RD      0x01 // an integer register was written
+#define COMMIT_LOG_FRD     0x02 // the register written was an FP register
+#define COMMIT_LOG_ADDR    0x04 // the instruction accessed memory
+#define COMMIT_LOG_INSN16  0x08 // the instruction is 2 bytes long
+#define COMMIT_LOG_INSN64  0x10 // the instruction is 8 bytes long
+
+struct commit_log_header_t
+{
+  uint8_t flags;
+  uint8_t rd;
+  uint16_t hart;
+  uint64_t pc;
+
+  // from the COMMIT_LOG_HEADER_SIZE bytes at p
+  void decode(const uint8_t* p);
+};
+
+// the little-endian value of the given number of bytes at p
+static inline uint64_t commit_log_get(const uint8_t* p, size_t bytes)
+{
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++)
+    value |= uint64_t(p[i]) << (8 * i);
+  return value;
+}
+
+// writes the commit log of every hart to one file. what's buffered is also
+// written if the simulator exits early.
+class commit_log_t
+{
+ public:
+  commit_log_t(const char* filename);
+  ~commit_log_t();
+
+  // start a new log in filename, dropping what hasn't been written yet
+  void reopen(const char* filename);
+
+  // addr is the address the instruction accessed, or NULL
+  void log(uint32_t hart, reg_t pc, insn_t insn, const commit_log_reg_t& rd, const reg_t* addr);
+
+ private:
+  static const size_t BUFFER_SIZE = 1 << 16;
+  static const size_t MAX_RECORD = COMMIT_LOG_HEADER_SIZE + 3 * sizeof(uint64_t);
+
+  FILE* file;
+  size_t len;
+  uint8_t buf[BUFFER_SIZE];
+
+  static std::vector<commit_log_t*> logs; // flushed at exit
+  static void flush_all();
+
+  void put(uint64_t value, size_t bytes)
+  {
+    for (size_t i = 0; i < bytes; i++)
+      buf[len++] = value >> (8 * i);
+  }
+  void open(const char* filename);
+  bool write();
+  void flush();
+};
+
+#endif
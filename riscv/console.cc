@@ -0,0 +1,133 @@
+// See LICENSE for license details.
+
+#include "console.h"
+#include "processor.h"
+#include "mmu.h"
+#include <unistd.h>
+#include <poll.h>
+#include <algorithm>
+#include <cstdlib>
+
+std::vector<console_t*> console_t::consoles;
+
+console_t::console_t()
+  : local_device_t({"read", "write", "write_buf"}), eof(false), detached(false)
+{
+  identity = "bcd";
+  tx.reserve(FIFO_SIZE);
+  if (consoles.empty())
+    atexit(flush_all);
+  consoles.push_back(this);
+}
+
+console_t::~console_t()
+{
+  consoles.erase(std::find(consoles.begin(), consoles.end(), this));
+  flush();
+}
+
+// the guest's last output may still be buffered when the simulation exits
+void console_t::flush_all()
+{
+  for (auto console : consoles)
+    console->flush();
+}
+
+bool console_t::command(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp)
+{
+  switch (cmd)
+  {
+    case 0:
+      if (!rx.empty())
+      {
+        *resp = 0x100 | (uint8_t)rx.front();
+        rx.pop_front();
+        return true;
+      }
+      reads.push_back(p);
+      return false;
+    case 1:
+    {
+      // the frontend doesn't answer writes, so drivers don't wait for one
+      char ch = payload;
+      transmit(&ch, 1);
+      return false;
+    }
+    case 2:
+    {
+      struct { uint64_t addr, len; } req;
+      *resp = ERROR;
+      if (!mmu->in_memory(payload, sizeof(req)))
+        return true;
+      mmu->load_bytes(payload, sizeof(req), &req);
+      if (!mmu->in_memory(req.addr, req.len))
+        return true;
+      char buf[FIFO_SIZE];
+      for (reg_t pos = 0; pos < req.len; pos += sizeof(buf))
+      {
+        size_t n = std::min<reg_t>(req.len - pos, sizeof(buf));
+        mmu->load_bytes(req.addr + pos, n, buf);
+        transmit(buf, n);
+      }
+      *resp = req.len;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void console_t::transmit(const char* buf, size_t len)
+{
+  if (tx.size() + len > FIFO_SIZE)
+    flush();
+  tx.insert(tx.end(), buf, buf + len);
+}
+
+void console_t::flush()
+{
+  // a sampling child's output is the parent's to write
+  for (size_t pos = 0; pos < tx.size() && !detached; )
+  {
+    ssize_t n = write(STDOUT_FILENO, &tx[pos], tx.size() - pos);
+    if (n <= 0)
+      break;
+    pos += n;
+  }
+  tx.clear();
+}
+
+void console_t::tick()
+{
+  // flush before waiting for input, so that prompts appear
+  flush();
+  if (reads.empty() || detached)
+    return;
+
+  if (rx.empty() && !eof)
+  {
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    char buf[FIFO_SIZE];
+    ssize_t n;
+    if (poll(&pfd, 1, 0) > 0 && (n = read(STDIN_FILENO, buf, sizeof(buf))) >= 0)
+    {
+      eof = n == 0;
+      rx.insert(rx.end(), buf, buf + n);
+    }
+  }
+
+  // the response raises the host interrupt on the core that asked
+  while (!rx.empty() && !reads.empty())
+  {
+    reads.front()->respond(reg_t(DEVICE) << 56 | 0x100 | (uint8_t)rx.front());
+    reads.pop_front();
+    rx.pop_front();
+  }
+}
+
+void console_t::detach()
+{
+  // the parent writes what was buffered and keeps reading the input
+  tx.clear();
+  detached = true;
+}
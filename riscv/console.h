@@ -0,0 +1,49 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_CONSOLE_H
+#define _RISCV_CONSOLE_H
+
+#include "localdev.h"
+#include <deque>
+
+// the console, served in the simulator with buffered host I/O. it takes
+// the place of the frontend's console device and speaks its protocol:
+// command 0 reads a character, responding with 0x100 | the character once
+// one has been typed, and command 1 writes the character in its payload,
+// with no response, as in the frontend.
+// command 2 writes a buffer, whose payload is the address of an {addr,
+// length} request, and responds with the length, or ERROR if the request
+// or buffer isn't in guest memory. output collects in the
+// transmit FIFO until it fills or the next quantum, and input is read a
+// batch at a time into the receive FIFO while the guest waits for it.
+class console_t : public local_device_t
+{
+ public:
+  static const uint8_t DEVICE = 1; // its number on the HTIF
+
+  console_t();
+  ~console_t();
+  void tick();
+  void detach();
+  bool busy() { return !reads.empty(); }
+
+ protected:
+  bool command(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp);
+
+ private:
+  static const size_t FIFO_SIZE = 4096;
+
+  std::vector<char> tx;
+  std::deque<char> rx;
+  std::deque<processor_t*> reads; // waiting for input
+  bool eof; // no more input
+  bool detached;
+
+  static std::vector<console_t*> consoles; // flushed at exit
+  static void flush_all();
+
+  void transmit(const char* buf, size_t len); // at most FIFO_SIZE bytes
+  void flush(); // or drop, once detached
+};
+
+#endif
@@ -0,0 +1,34 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_DIRTYMAP_H
+#define _RISCV_DIRTYMAP_H
+
+#include "mmu.h"
+#include <algorithm>
+#include <vector>
+
+// a bit per page of guest memory, set when the page is written to. MMUs
+// mark a page when they refill their TLB for a store to it, so after a
+// clear() their TLBs must be flushed for later writes to be seen; see
+// sim_t::clear_dirty_pages.
+class dirty_map_t
+{
+ public:
+  dirty_map_t(size_t memsz) : bits((memsz / PGSIZE + 63) / 64) {}
+
+  void mark(reg_t paddr)
+  {
+    reg_t page = paddr / PGSIZE;
+    bits[page / 64] |= uint64_t(1) << (page % 64);
+  }
+  bool dirty(size_t page)
+  {
+    return (bits[page / 64] >> (page % 64)) & 1;
+  }
+  void clear() { std::fill(bits.begin(), bits.end(), 0); }
+
+ private:
+  std::vector<uint64_t> bits;
+};
+
+#endif
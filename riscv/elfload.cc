@@ -0,0 +1,92 @@
+// See LICENSE for license details.
+
+#include "elfload.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// segments at least this big are mapped rather than read
+static const size_t MAP_THRESHOLD = 1 << 20;
+
+static void bad_elf(const char* filename)
+{
+  fprintf(stderr, "couldn't load %s\n", filename);
+  exit(1);
+}
+
+static void read_fully(int fd, void* buf, size_t len, off_t offset, const char* filename)
+{
+  for (char* p = (char*)buf; len; )
+  {
+    ssize_t n = pread(fd, p, len, offset);
+    if (n <= 0)
+      bad_elf(filename);
+    p += n, offset += n, len -= n;
+  }
+}
+
+static void load_segment(int fd, off_t offset, size_t len, char* dst, const char* filename)
+{
+  size_t pgsize = sysconf(_SC_PAGESIZE);
+  size_t head = -(uintptr_t)dst % pgsize; // up to the first whole host page
+
+  if (len >= MAP_THRESHOLD && (offset + head) % pgsize == 0)
+  {
+    size_t pages = (len - head) / pgsize * pgsize;
+    if (mmap(dst + head, pages, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, offset + head) == MAP_FAILED)
+      bad_elf(filename);
+    read_fully(fd, dst, head, offset, filename);
+    read_fully(fd, dst + head + pages, len - head - pages, offset + head + pages, filename);
+  }
+  else
+    read_fully(fd, dst, len, offset, filename);
+}
+
+template<class Ehdr, class Phdr>
+static reg_t load(int fd, char* mem, size_t memsz, const char* filename)
+{
+  Ehdr eh;
+  read_fully(fd, &eh, sizeof(eh), 0, filename);
+  if (eh.e_phentsize != sizeof(Phdr))
+    bad_elf(filename);
+
+  std::vector<Phdr> ph(eh.e_phnum);
+  read_fully(fd, ph.data(), ph.size() * sizeof(Phdr), eh.e_phoff, filename);
+  for (auto& seg : ph)
+  {
+    if (seg.p_type != PT_LOAD || seg.p_memsz == 0)
+      continue;
+    if (seg.p_filesz > seg.p_memsz || seg.p_paddr > memsz || seg.p_memsz > memsz - seg.p_paddr)
+    {
+      fprintf(stderr, "%s doesn't fit in target memory\n", filename);
+      exit(1);
+    }
+    load_segment(fd, seg.p_offset, seg.p_filesz, mem + seg.p_paddr, filename);
+  }
+  return eh.e_entry;
+}
+
+bool load_elf_segments(const char* filename, char* mem, size_t memsz, reg_t* entry)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  unsigned char ident[EI_NIDENT];
+  read_fully(fd, ident, sizeof(ident), 0, filename);
+  if (memcmp(ident, ELFMAG, SELFMAG) != 0)
+    bad_elf(filename);
+  else if (ident[EI_CLASS] == ELFCLASS64)
+    *entry = load<Elf64_Ehdr, Elf64_Phdr>(fd, mem, memsz, filename);
+  else
+    *entry = load<Elf32_Ehdr, Elf32_Phdr>(fd, mem, memsz, filename);
+
+  close(fd);
+  return true;
+}
@@ -0,0 +1,16 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_ELFLOAD_H
+#define _RISCV_ELFLOAD_H
+
+#include "decode.h"
+#include <cstddef>
+
+// load the PT_LOAD segments of an ELF file straight into target memory
+// mem, of memsz bytes, at their physical addresses, and return its entry
+// point in *entry. large segments are mapped copy-on-write from the file
+// rather than read. bss isn't written, so mem must still be all zeros.
+// returns false if the file can't be opened; exits if it isn't loadable.
+bool load_elf_segments(const char* filename, char* mem, size_t memsz, reg_t* entry);
+
+#endif
@@ -3,9 +3,12 @@
 
 #include "processor.h"
 #include "disasm.h"
+#include <string>
 #include <vector>
 #include <functional>
 
+class stats_t;
+
 class extension_t
 {
  public:
@@ -14,6 +17,11 @@ class extension_t
   virtual const char* name() = 0;
   virtual void reset() {};
   virtual void set_debug(bool value) {};
+  // add counters named prefix + <counter> to stats
+  virtual void register_stats(stats_t* stats, const std::string& prefix) {};
+  // write the extension's architectural state to a checkpoint; read it back
+  virtual void save_state(FILE* f) {};
+  virtual void restore_state(FILE* f) {};
   virtual ~extension_t();
 
   void set_processor(processor_t* _p) { p = _p; }
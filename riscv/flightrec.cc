@@ -0,0 +1,12 @@
+// See LICENSE for license details.
+
+#include "flightrec.h"
+
+flight_recorder_t::flight_recorder_t(size_t size)
+  : next(0)
+{
+  size_t n = 1;
+  while (n < size)
+    n *= 2;
+  entries.resize(n);
+}
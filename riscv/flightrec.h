@@ -0,0 +1,49 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_FLIGHTREC_H
+#define _RISCV_FLIGHTREC_H
+
+#include "processor.h"
+#include <vector>
+
+// a ring buffer of a hart's most recently retired blocks of instructions,
+// and of the traps between them, kept for post-mortem debugging. a block
+// is what the stepping loop retired without looking up a decoded
+// instruction: usually a basic block, or a single instruction when the
+// simulator is instrumenting every one.
+class flight_recorder_t
+{
+ public:
+  struct entry_t
+  {
+    reg_t pc; // the block's first instruction, or the one that trapped
+    reg_t next; // the PC the block went on to, or the trap's cause
+    uint64_t insns; // retired in the block; 0 for a trap
+  };
+
+  // holds the last size entries, rounded up to a power of 2
+  flight_recorder_t(size_t size);
+
+  void record(reg_t pc, reg_t next, uint64_t insns)
+  {
+    entry_t& e = entries[this->next++ & (entries.size() - 1)];
+    e.pc = pc;
+    e.next = next;
+    e.insns = insns;
+  }
+  void record_trap(reg_t epc, reg_t cause) { record(epc, cause, 0); }
+
+  // the number of entries held
+  size_t size() { return next < entries.size() ? next : entries.size(); }
+  // the i-th oldest entry held
+  const entry_t& operator[](size_t i)
+  {
+    return entries[(next - size() + i) & (entries.size() - 1)];
+  }
+
+ private:
+  std::vector<entry_t> entries;
+  uint64_t next; // entries recorded so far
+};
+
+#endif
@@ -0,0 +1,74 @@
+// See LICENSE for license details.
+
+#include "histogram.h"
+#include "symtab.h"
+#include <cinttypes>
+#include <algorithm>
+#include <map>
+
+pc_histogram_t::pc_histogram_t()
+  : table(4096, (entry_t){EMPTY, 0}), used(0), bits(12)
+{
+}
+
+void pc_histogram_t::insert(size_t i, reg_t pc)
+{
+  table[i] = (entry_t){pc, 1};
+  if (++used * 2 <= table.size())
+    return;
+
+  std::vector<entry_t> old(table.size() * 2, (entry_t){EMPTY, 0});
+  old.swap(table);
+  bits++;
+  for (auto& e : old)
+  {
+    if (e.pc == EMPTY)
+      continue;
+    size_t j = hash(e.pc);
+    while (table[j].pc != EMPTY)
+      j = (j + 1) & (table.size() - 1);
+    table[j] = e;
+  }
+}
+
+void pc_histogram_t::print(FILE* out, const char* title, const symtab_t* symbols)
+{
+  std::vector<entry_t> pcs;
+  uint64_t total = 0;
+  for (auto& e : table)
+    if (e.pc != EMPTY)
+      pcs.push_back(e), total += e.count;
+  if (total == 0)
+    return;
+
+  auto by_count = [](const entry_t& a, const entry_t& b) { return a.count > b.count; };
+  std::sort(pcs.begin(), pcs.end(), by_count);
+
+  fprintf(out, "%s PC histogram: %zu PCs, %" PRIu64 " instructions\n", title, pcs.size(), total);
+  for (auto& e : pcs)
+  {
+    fprintf(out, "0x%016" PRIx64 " %12" PRIu64 " %6.2f%%", e.pc, e.count, 100.0 * e.count / total);
+    if (symbols)
+      fprintf(out, " %s", symbols->describe(e.pc).c_str());
+    fputc('\n', out);
+  }
+
+  if (!symbols)
+    return;
+
+  std::map<std::string, uint64_t> by_symbol;
+  for (auto& e : pcs)
+  {
+    const symbol_t* s = symbols->lookup(e.pc);
+    by_symbol[s ? s->name : "(no symbol)"] += e.count;
+  }
+  std::vector<std::pair<std::string, uint64_t>> syms(by_symbol.begin(), by_symbol.end());
+  std::sort(syms.begin(), syms.end(),
+            [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) {
+              return a.second > b.second;
+            });
+
+  fprintf(out, "%s symbol histogram: %zu symbols\n", title, syms.size());
+  for (auto& s : syms)
+    fprintf(out, "%12" PRIu64 " %6.2f%% %s\n", s.second, 100.0 * s.second / total, s.first.c_str());
+}
@@ -0,0 +1,54 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HISTOGRAM_H
+#define _RISCV_HISTOGRAM_H
+
+#include "decode.h"
+#include <cstdio>
+#include <vector>
+
+class symtab_t;
+
+// counts retired instructions per PC in an open-addressed hash table
+class pc_histogram_t
+{
+ public:
+  pc_histogram_t();
+
+  void add(reg_t pc)
+  {
+    size_t i = hash(pc);
+    while (unlikely(table[i].pc != pc))
+    {
+      if (table[i].pc == EMPTY)
+      {
+        insert(i, pc);
+        return;
+      }
+      i = (i + 1) & (table.size() - 1);
+    }
+    table[i].count++;
+  }
+
+  // print the PCs in decreasing order of count and, given symbols, the
+  // counts aggregated per symbol
+  void print(FILE* out, const char* title, const symtab_t* symbols);
+
+ private:
+  static const reg_t EMPTY = -1; // PCs are at least 2-byte aligned
+
+  struct entry_t
+  {
+    reg_t pc;
+    uint64_t count;
+  };
+  std::vector<entry_t> table; // a power of two, at most half full
+  size_t used;
+
+  size_t hash(reg_t pc) { return ((pc >> 1) * 0x9e3779b97f4a7c15ULL) >> (64 - bits); }
+  int bits;
+
+  void insert(size_t i, reg_t pc);
+};
+
+#endif
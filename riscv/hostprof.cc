@@ -0,0 +1,44 @@
+// See LICENSE for license details.
+
+#include "hostprof.h"
+#include <cinttypes>
+
+static const char* host_category_name[NUM_HOST_CATEGORIES] = {
+  "other",
+  "dispatch",
+  "trap",
+  "tlb refill",
+  "htif",
+  "extension",
+};
+
+host_profiler_t::host_profiler_t()
+  : depth(0), current(HOST_OTHER)
+{
+  for (size_t i = 0; i < NUM_HOST_CATEGORIES; i++)
+    ticks[i] = 0;
+  start_time = std::chrono::steady_clock::now();
+  start_ticks = last = now();
+}
+
+void host_profiler_t::print(FILE* out, uint64_t insns)
+{
+  uint64_t t = now();
+  ticks[current] += t - last;
+  last = t;
+
+  // calibrate the cycle counter against the wall clock
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start_time).count();
+  double ns_per_tick = t == start_ticks ? 0 : ns / (t - start_ticks);
+
+  fprintf(out, "host: %" PRIu64 " instructions in %.3f s, %.2f MIPS\n",
+          insns, ns * 1e-9, ns ? insns * 1e3 / ns : 0);
+  for (size_t i = 0; i < NUM_HOST_CATEGORIES; i++)
+  {
+    double c_ns = ticks[i] * ns_per_tick;
+    fprintf(out, "host: %-12s %10.3f s %6.2f%% %8.2f ns/insn\n",
+            host_category_name[i], c_ns * 1e-9, ns ? 100 * c_ns / ns : 0,
+            insns ? c_ns / insns : 0);
+  }
+}
@@ -0,0 +1,95 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOSTPROF_H
+#define _RISCV_HOSTPROF_H
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+// the parts of the simulator whose host time is measured
+enum host_category_t
+{
+  HOST_OTHER, // everything outside the other categories
+  HOST_DISPATCH, // fetching, decoding and executing instructions
+  HOST_TRAP,
+  HOST_TLB_REFILL,
+  HOST_HTIF,
+  HOST_EXTENSION,
+  NUM_HOST_CATEGORIES
+};
+
+// measures where the simulator itself spends its time, by reading the
+// host's cycle counter when entering and leaving each category. time is
+// exclusive: a TLB refill during dispatch counts only as a TLB refill.
+class host_profiler_t
+{
+ public:
+  host_profiler_t();
+
+  void enter(host_category_t c)
+  {
+    uint64_t t = now();
+    ticks[current] += t - last;
+    stack[depth++] = current;
+    current = c;
+    last = t;
+  }
+  void leave()
+  {
+    uint64_t t = now();
+    ticks[current] += t - last;
+    current = stack[--depth];
+    last = t;
+  }
+
+  // report the time in each category, and the MIPS achieved for insns
+  // retired instructions, since construction
+  void print(FILE* out, uint64_t insns);
+
+ private:
+  static const size_t MAX_DEPTH = 16;
+
+  uint64_t ticks[NUM_HOST_CATEGORIES];
+  host_category_t stack[MAX_DEPTH];
+  size_t depth;
+  host_category_t current;
+  uint64_t last;
+  uint64_t start_ticks;
+  std::chrono::steady_clock::time_point start_time;
+
+  static uint64_t now()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+};
+
+// charges the time until it goes out of scope, even by way of an
+// exception, to category c; does nothing if profiler is NULL
+class host_timer_t
+{
+ public:
+  host_timer_t(host_profiler_t* profiler, host_category_t c) : profiler(profiler)
+  {
+    if (profiler)
+      profiler->enter(c);
+  }
+  ~host_timer_t()
+  {
+    if (profiler)
+      profiler->leave();
+  }
+
+ private:
+  host_profiler_t* profiler;
+};
+
+#endif
@@ -3,6 +3,8 @@
 #include "htif.h"
 #include "sim.h"
 #include "encoding.h"
+#include "stats.h"
+#include "hostprof.h"
 #include <unistd.h>
 #include <stdexcept>
 #include <stdlib.h>
@@ -10,33 +12,135 @@
 #include <assert.h>
 #include <stddef.h>
 #include <poll.h>
+#include <algorithm>
+
+htif_port_t::htif_port_t(sim_t* _sim)
+  : sim(_sim), in_reset(true), polled_idle(false),
+    packets(0), mem_reads(0), mem_writes(0), cr_reads(0), cr_writes(0)
+{
+}
+
+void htif_port_t::read_mem(reg_t addr, size_t len, void* dst)
+{
+  sim->debug_mmu->load_bytes(addr, len, dst);
+  mem_reads += len / HTIF_DATA_ALIGN;
+}
+
+void htif_port_t::write_mem(reg_t addr, size_t len, const void* src)
+{
+  sim->debug_mmu->store_bytes(addr, len, src);
+  mem_writes += len / HTIF_DATA_ALIGN;
+}
+
+reg_t htif_port_t::access_cr(uint32_t coreid, uint16_t regno, bool write, reg_t val)
+{
+  (write ? cr_writes : cr_reads)++;
+
+  if ((coreid & 0xFFFFF) == 0xFFFFF) // system control register space
+    return sim->get_scr(regno);
+
+  processor_t* proc = sim->get_core(coreid);
+  reg_t old_val;
+  switch (regno)
+  {
+    case CSR_MTOHOST:
+      old_val = proc->get_state()->tohost;
+      polled_idle = old_val == 0;
+      if (write)
+        proc->get_state()->tohost = val;
+      break;
+    case CSR_MFROMHOST:
+      old_val = proc->get_state()->fromhost;
+      if (write && old_val == 0)
+        proc->get_state()->fromhost = val;
+      break;
+    case CSR_MRESET:
+      old_val = !proc->running();
+      if (write)
+      {
+        in_reset = in_reset & (val & 1);
+        proc->reset(val & 1);
+      }
+      break;
+    default:
+      abort();
+  }
+  return old_val;
+}
+
+void htif_port_t::register_stats(stats_t* stats)
+{
+  stats->add("htif.packets", &packets);
+  stats->add("htif.mem_reads", &mem_reads);
+  stats->add("htif.mem_writes", &mem_writes);
+  stats->add("htif.cr_reads", &cr_reads);
+  stats->add("htif.cr_writes", &cr_writes);
+}
+
+bool htif_port_t::load_directly(const std::vector<std::string>& args)
+{
+  return sim->direct_load && !args.empty() && sim->load_elf(args[0].c_str());
+}
+
+bool htif_port_t::done()
+{
+  if (in_reset)
+    return false;
+  return !sim->running();
+}
 
 htif_isasim_t::htif_isasim_t(sim_t* _sim, const std::vector<std::string>& args)
-  : htif_pthread_t(args), sim(_sim), reset(true), seqno(1)
+  : htif_pthread_t(args), htif_port_t(_sim), seqno(1)
+{
+}
+
+int htif_isasim_t::serve()
 {
+  while (!sim->sample_done && tick())
+    sim->run_quantum();
+  return exit_code();
+}
+
+void htif_isasim_t::load_program()
+{
+  if (!load_directly(target_args()))
+    htif_pthread_t::load_program();
 }
 
 bool htif_isasim_t::tick()
 {
+  // a sampling child has no frontend; it stays with the parent
+  if (sim->sample_child)
+    return true;
+
+  host_timer_t timer(sim->host_profiler, HOST_HTIF);
   if (done())
     return false;
 
-  do tick_once(); while (reset);
+  // serve packets until the frontend polls tohost and finds nothing, so a
+  // request is seen through to its response in one stop. the frontend only
+  // runs while we wait for a packet, and may finish meanwhile.
+  polled_idle = false;
+  while (in_reset || !polled_idle)
+  {
+    packet_header_t hdr;
+    while (!recv_nonblocking(&hdr, sizeof(hdr)))
+      if (done())
+        return false;
+    serve_packet(hdr);
+  }
 
   return true;
 }
 
-void htif_isasim_t::tick_once()
+void htif_isasim_t::serve_packet(const packet_header_t& hdr)
 {
-  packet_header_t hdr;
-  recv(&hdr, sizeof(hdr));
-
-  char buf[hdr.get_packet_size()];
-  memcpy(buf, &hdr, sizeof(hdr));
-  recv(buf + sizeof(hdr), hdr.get_payload_size());
-  packet_t p(buf);
+  // big enough for the payload of a write, or the reply to a read
+  buf.resize(std::max<size_t>(hdr.data_size, 1) * HTIF_DATA_ALIGN);
+  recv(&buf[0], hdr.get_payload_size());
 
   assert(hdr.seqno == seqno);
+  packets++;
 
   switch (hdr.cmd)
   {
@@ -45,17 +149,14 @@ void htif_isasim_t::tick_once()
       packet_header_t ack(HTIF_CMD_ACK, seqno, hdr.data_size, 0);
       send(&ack, sizeof(ack));
 
-      uint64_t buf[hdr.data_size];
-      for (size_t i = 0; i < hdr.data_size; i++)
-        buf[i] = sim->debug_mmu->load_uint64((hdr.addr+i)*HTIF_DATA_ALIGN);
-      send(buf, hdr.data_size * sizeof(buf[0]));
+      size_t len = hdr.data_size * HTIF_DATA_ALIGN;
+      read_mem(hdr.addr * HTIF_DATA_ALIGN, len, &buf[0]);
+      send(&buf[0], len);
       break;
     }
     case HTIF_CMD_WRITE_MEM:
     {
-      const uint64_t* buf = (const uint64_t*)p.get_payload();
-      for (size_t i = 0; i < hdr.data_size; i++)
-        sim->debug_mmu->store_uint64((hdr.addr+i)*HTIF_DATA_ALIGN, buf[i]);
+      write_mem(hdr.addr * HTIF_DATA_ALIGN, hdr.data_size * HTIF_DATA_ALIGN, &buf[0]);
 
       packet_header_t ack(HTIF_CMD_ACK, seqno, 0, 0);
       send(&ack, sizeof(ack));
@@ -65,49 +166,15 @@ void htif_isasim_t::tick_once()
     case HTIF_CMD_WRITE_CONTROL_REG:
     {
       assert(hdr.data_size == 1);
-      reg_t coreid = hdr.addr >> 20;
-      reg_t regno = hdr.addr & ((1<<20)-1);
-      uint64_t old_val, new_val = 0 /* shut up gcc */;
-
-      packet_header_t ack(HTIF_CMD_ACK, seqno, 1, 0);
-      send(&ack, sizeof(ack));
-
-      if (coreid == 0xFFFFF) // system control register space
-      {
-        uint64_t scr = sim->get_scr(regno);
-        send(&scr, sizeof(scr));
-        break;
-      }
-
-      processor_t* proc = sim->get_core(coreid);
       bool write = hdr.cmd == HTIF_CMD_WRITE_CONTROL_REG;
+      uint64_t new_val = 0;
       if (write)
-        memcpy(&new_val, p.get_payload(), sizeof(new_val));
+        memcpy(&new_val, &buf[0], sizeof(new_val));
 
-      switch (regno)
-      {
-        case CSR_MTOHOST:
-          old_val = proc->get_state()->tohost;
-          if (write)
-            proc->get_state()->tohost = new_val;
-          break;
-        case CSR_MFROMHOST:
-          old_val = proc->get_state()->fromhost;
-          if (write && old_val == 0)
-            proc->get_state()->fromhost = new_val;
-          break;
-        case CSR_MRESET:
-          old_val = !proc->running();
-          if (write)
-          {
-            reset = reset & (new_val & 1);
-            proc->reset(new_val & 1);
-          }
-          break;
-        default:
-          abort();
-      }
+      packet_header_t ack(HTIF_CMD_ACK, seqno, 1, 0);
+      send(&ack, sizeof(ack));
 
+      uint64_t old_val = access_cr(hdr.addr >> 20, hdr.addr & ((1<<20)-1), write, new_val);
       send(&old_val, sizeof(old_val));
       break;
     }
@@ -117,9 +184,49 @@ void htif_isasim_t::tick_once()
   seqno++;
 }
 
-bool htif_isasim_t::done()
+htif_inproc_t::htif_inproc_t(sim_t* _sim, const std::vector<std::string>& args)
+  : htif_t(args), htif_port_t(_sim)
 {
-  if (reset)
-    return false;
-  return !sim->running();
+}
+
+int htif_inproc_t::serve()
+{
+  // the quanta the frontend simulates are charged to dispatch, not here
+  host_timer_t timer(sim->host_profiler, HOST_HTIF);
+  return run();
+}
+
+void htif_inproc_t::load_program()
+{
+  if (!load_directly(target_args()))
+    htif_t::load_program();
+}
+
+reg_t htif_inproc_t::read_cr(uint32_t coreid, uint16_t regnum)
+{
+  packets++;
+  return access_cr(coreid, regnum, false, 0);
+}
+
+reg_t htif_inproc_t::write_cr(uint32_t coreid, uint16_t regnum, reg_t val)
+{
+  // the frontend polls every core's tohost in turn, once the program is
+  // loaded and the cores are out of reset
+  if (coreid == 0 && regnum == CSR_MTOHOST && !in_reset)
+    sim->run_quantum();
+
+  packets++;
+  return access_cr(coreid, regnum, true, val);
+}
+
+void htif_inproc_t::read_chunk(addr_t taddr, size_t len, void* dst)
+{
+  packets++;
+  read_mem(taddr, len, dst);
+}
+
+void htif_inproc_t::write_chunk(addr_t taddr, size_t len, const void* src)
+{
+  packets++;
+  write_mem(taddr, len, src);
 }
@@ -4,28 +4,90 @@
 #define _HTIF_H
 
 #include <fesvr/htif_pthread.h>
+#include <vector>
+#include <stdlib.h>
 
 class sim_t;
-struct packet;
+class stats_t;
+struct packet_header_t;
+
+// the machine's end of the host-target interface, through which the
+// frontend loads programs, proxies syscalls, and resets the cores.
+class htif_port_t
+{
+public:
+  htif_port_t(sim_t* _sim);
+  virtual ~htif_port_t() {}
+  // run the simulation until the frontend is done; returns its exit code
+  virtual int serve() = 0;
+  // service the frontend's pending requests; false once it is done
+  virtual bool tick() = 0;
+  bool done();
+  void register_stats(stats_t* stats);
+
+protected:
+  sim_t* sim;
+  bool in_reset; // until the frontend first releases a core
+  bool polled_idle; // the frontend last found tohost empty
+  uint64_t packets; // requests
+  uint64_t mem_reads; // in words
+  uint64_t mem_writes;
+  uint64_t cr_reads;
+  uint64_t cr_writes;
+
+  void read_mem(reg_t addr, size_t len, void* dst);
+  void write_mem(reg_t addr, size_t len, const void* src);
+  // returns the control register's old value
+  reg_t access_cr(uint32_t coreid, uint16_t regno, bool write, reg_t val);
+  // load the target program ourselves, if the simulator was asked to and
+  // the frontend needn't search for it; false if the frontend should
+  bool load_directly(const std::vector<std::string>& args);
+};
 
 // this class implements the host-target interface for program loading, etc.
 // a simpler implementation would implement the high-level interface
 // (read/write cr, read/write chunk) directly, but we implement the lower-
 // level serialized interface to be more similar to real target machines.
 
-class htif_isasim_t : public htif_pthread_t
+class htif_isasim_t : public htif_pthread_t, public htif_port_t
 {
 public:
   htif_isasim_t(sim_t* _sim, const std::vector<std::string>& args);
+  int serve();
   bool tick();
-  bool done();
+  using htif_port_t::done;
+
+protected:
+  void load_program();
 
 private:
-  sim_t* sim;
-  bool reset;
   uint8_t seqno;
+  std::vector<char> buf; // payload of the current packet, reused
+
+  void serve_packet(const packet_header_t& hdr);
+};
+
+// this one is the simpler implementation: the frontend runs on the
+// simulation thread and calls into the machine directly. the machine
+// simulates a quantum each time the frontend polls core 0's tohost.
+class htif_inproc_t : public htif_t, public htif_port_t
+{
+public:
+  htif_inproc_t(sim_t* _sim, const std::vector<std::string>& args);
+  int serve();
+  bool tick() { return !done(); } // the frontend only runs between quanta
+  using htif_port_t::done;
 
-  void tick_once();
+protected:
+  void load_program();
+  reg_t read_cr(uint32_t coreid, uint16_t regnum);
+  reg_t write_cr(uint32_t coreid, uint16_t regnum, reg_t val);
+  void read_chunk(addr_t taddr, size_t len, void* dst);
+  void write_chunk(addr_t taddr, size_t len, const void* src);
+  size_t chunk_align() { return HTIF_DATA_ALIGN; }
+  size_t chunk_max_size() { return 1 << 20; }
+  ssize_t read(void* buf, size_t max_size) { abort(); }
+  ssize_t write(const void* buf, size_t size) { abort(); }
 };
 
 #endif
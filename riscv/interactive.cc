@@ -71,6 +71,9 @@ void sim_t::interactive()
   funcs["str"] = &sim_t::interactive_str;
   funcs["until"] = &sim_t::interactive_until;
   funcs["while"] = &sim_t::interactive_until;
+  funcs["mix"] = &sim_t::interactive_mix;
+  funcs["history"] = &sim_t::interactive_history;
+  funcs["checkpoint"] = &sim_t::interactive_checkpoint;
   funcs["quit"] = &sim_t::interactive_quit;
   funcs["q"] = funcs["quit"];
   funcs["help"] = &sim_t::interactive_help;
@@ -121,6 +124,9 @@ void sim_t::interactive_help(const std::string& cmd, const std::vector<std::stri
     "while reg <core> <reg> <val>    # Run while <reg> in <core> is <val>\n"
     "while pc <core> <val>           # Run while PC in <core> is <val>\n"
     "while mem <addr> <val>          # Run while memory <addr> is <val>\n"
+    "mix <core>                      # Show the instruction mix of <core> so far (needs --insn-mix)\n"
+    "history <core> [n]              # Show the last [n] blocks <core> retired (needs --flight-recorder)\n"
+    "checkpoint <file>               # Save the state of the machine to <file>\n"
     "run [count]                     # Resume noisy execution (until CTRL+C, or [count] insns)\n"
     "r [count]                         Alias for run\n"
     "rs [count]                      # Resume silent execution (until CTRL+C, or [count] insns)\n"
@@ -153,6 +159,7 @@ void sim_t::interactive_run(const std::string& cmd, const std::vector<std::strin
 
 void sim_t::interactive_quit(const std::string& cmd, const std::vector<std::string>& args)
 {
+  recorded = NULL; // not a failure, so don't print the flight recorders
   exit(0);
 }
 
@@ -165,6 +172,34 @@ reg_t sim_t::get_pc(const std::vector<std::string>& args)
   return p->state.pc;
 }
 
+void sim_t::interactive_mix(const std::string& cmd, const std::vector<std::string>& args)
+{
+  if (args.size() != 1)
+    throw trap_illegal_instruction();
+
+  get_core(args[0])->print_insn_mix(stderr);
+}
+
+void sim_t::interactive_history(const std::string& cmd, const std::vector<std::string>& args)
+{
+  if (args.size() != 1 && args.size() != 2)
+    throw trap_illegal_instruction();
+
+  size_t n = args.size() == 2 ? atoll(args[1].c_str()) : SIZE_MAX;
+  get_core(args[0])->print_flight_recorder(stderr, n);
+}
+
+void sim_t::interactive_checkpoint(const std::string& cmd, const std::vector<std::string>& args)
+{
+  if (args.size() != 1)
+    throw trap_illegal_instruction();
+
+  if (devices_busy())
+    fprintf(stderr, "a device has a request outstanding; run on and try again\n");
+  else
+    save_checkpoint(args[0].c_str());
+}
+
 void sim_t::interactive_pc(const std::string& cmd, const std::vector<std::string>& args)
 {
   fprintf(stderr, "0x%016" PRIx64 "\n", get_pc(args));
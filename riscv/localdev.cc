@@ -0,0 +1,24 @@
+// See LICENSE for license details.
+
+#include "localdev.h"
+#include "mmu.h"
+#include <cstring>
+
+bool local_device_t::handle(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp)
+{
+  if (cmd != IDENTIFY)
+    return command(p, mmu, cmd, payload, resp);
+
+  // write the name of command (payload % 256), or the device's identity if
+  // that is 255, to the 64 bytes at (payload / 256)
+  static const size_t IDENTITY_SIZE = 64;
+  char id[IDENTITY_SIZE] = {0};
+  size_t what = payload % 256;
+  const std::string& name = what == IDENTIFY ? identity :
+                            what < commands.size() ? commands[what] : std::string();
+  strncpy(id, name.c_str(), IDENTITY_SIZE - 1);
+  if (mmu->in_memory(payload / 256, IDENTITY_SIZE))
+    mmu->store_bytes(payload / 256, IDENTITY_SIZE, id);
+  *resp = 1;
+  return true;
+}
@@ -0,0 +1,49 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_LOCALDEV_H
+#define _RISCV_LOCALDEV_H
+
+#include "decode.h"
+#include <string>
+#include <vector>
+
+class mmu_t;
+class processor_t;
+
+// a device the guest drives through tohost, with the frontend's command
+// encoding (device << 56 | command << 48 | payload), but which the
+// simulator serves itself as soon as tohost is written, with no round trip
+// to the frontend. responses go to fromhost, raising the host interrupt.
+class local_device_t
+{
+ public:
+  static const uint8_t IDENTIFY = 255;
+  static const reg_t ERROR = (reg_t(1) << 48) - 1; // a response, all payload bits set
+
+  // commands are the names of commands 0, 1, ...
+  local_device_t(const std::vector<std::string>& commands) : commands(commands) {}
+  virtual ~local_device_t() {}
+
+  // serve command cmd from core p, accessing guest memory through mmu;
+  // returns whether to respond with *resp now. a later response can be
+  // delivered with p->respond. a request naming memory that doesn't exist
+  // mustn't fault the guest, whose csrw to tohost is what's executing.
+  bool handle(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp);
+  // called every quantum, and before the frontend services a request
+  virtual void tick() {}
+  // called in a forked sampling child, which mustn't affect the host
+  virtual void detach() {}
+  // whether a request awaits a later response. devices aren't saved in
+  // checkpoints, so none is taken while one is busy.
+  virtual bool busy() { return false; }
+
+ protected:
+  virtual bool command(processor_t* p, mmu_t* mmu, uint8_t cmd, reg_t payload, reg_t* resp) = 0;
+
+  std::string identity; // what identify reports, e.g. "disk size=1024"
+
+ private:
+  std::vector<std::string> commands;
+};
+
+#endif
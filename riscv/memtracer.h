@@ -7,6 +7,16 @@
 #include <string.h>
 #include <vector>
 
+// a virtual address translated through the page tables
+struct translation_t
+{
+  uint64_t vaddr;
+  uint64_t pgsize;       // the size of the page or superpage mapping vaddr
+  unsigned ptesize;      // the size of each PTE in bytes
+  unsigned levels;       // the number of PTEs the walk read
+  uint64_t pte_addr[4];  // their physical addresses, root first
+};
+
 class memtracer_t
 {
  public:
@@ -14,31 +24,64 @@ class memtracer_t
   virtual ~memtracer_t() {}
 
   virtual bool interested_in_range(uint64_t begin, uint64_t end, bool store, bool fetch) = 0;
-  virtual void trace(uint64_t addr, size_t bytes, bool store, bool fetch) = 0;
+  // addr is physical, and vaddr the virtual address it was accessed at;
+  // pc is the virtual address of the instruction performing the access
+  virtual void trace(uint64_t addr, size_t bytes, bool store, bool fetch, uint64_t vaddr, uint64_t pc) = 0;
+
+  // TLB models see every translation of the accesses they are interested
+  // in, bypassing the simulator's own TLB, and every sfence.vm
+  virtual bool interested_in_translation(bool fetch) { return false; }
+  virtual void translate(const translation_t& t, bool store, bool fetch, uint64_t pc) {}
+  virtual void flush_translations() {}
 };
 
 class memtracer_list_t : public memtracer_t
 {
  public:
-  bool empty() { return list.empty(); }
+  memtracer_list_t() : enabled(true) {}
+  bool empty() { return !enabled || list.empty(); }
   bool interested_in_range(uint64_t begin, uint64_t end, bool store, bool fetch)
   {
+    if (!enabled)
+      return false;
     for (std::vector<memtracer_t*>::iterator it = list.begin(); it != list.end(); ++it)
       if ((*it)->interested_in_range(begin, end, store, fetch))
         return true;
     return false;
   }
-  void trace(uint64_t addr, size_t bytes, bool store, bool fetch)
+  void trace(uint64_t addr, size_t bytes, bool store, bool fetch, uint64_t vaddr, uint64_t pc)
+  {
+    for (std::vector<memtracer_t*>::iterator it = list.begin(); it != list.end(); ++it)
+      (*it)->trace(addr, bytes, store, fetch, vaddr, pc);
+  }
+  bool interested_in_translation(bool fetch)
+  {
+    if (!enabled)
+      return false;
+    for (std::vector<memtracer_t*>::iterator it = list.begin(); it != list.end(); ++it)
+      if ((*it)->interested_in_translation(fetch))
+        return true;
+    return false;
+  }
+  void translate(const translation_t& t, bool store, bool fetch, uint64_t pc)
+  {
+    for (std::vector<memtracer_t*>::iterator it = list.begin(); it != list.end(); ++it)
+      if ((*it)->interested_in_translation(fetch))
+        (*it)->translate(t, store, fetch, pc);
+  }
+  void flush_translations()
   {
     for (std::vector<memtracer_t*>::iterator it = list.begin(); it != list.end(); ++it)
-      (*it)->trace(addr, bytes, store, fetch);
+      (*it)->flush_translations();
   }
   void hook(memtracer_t* h)
   {
     list.push_back(h);
   }
+  void set_enabled(bool value) { enabled = value; }
  private:
   std::vector<memtracer_t*> list;
+  bool enabled;
 };
 
 #endif
@@ -3,9 +3,14 @@
 #include "mmu.h"
 #include "sim.h"
 #include "processor.h"
+#include "stats.h"
+#include "hostprof.h"
+#include "dirtymap.h"
 
 mmu_t::mmu_t(char* _mem, size_t _memsz)
- : mem(_mem), memsz(_memsz), proc(NULL)
+ : mem(_mem), memsz(_memsz), proc(NULL), dirty(NULL), refetch(false),
+   logging(false), logged_access(false), logged_addr(0),
+   counting(true), icache_misses(0), tlb_refills(0), page_walks(0)
 {
   flush_tlb();
 }
@@ -33,8 +38,10 @@ void* mmu_t::refill_tlb(reg_t addr, reg_t bytes, bool store, bool fetch)
 {
   reg_t idx = (addr >> PGSHIFT) % TLB_ENTRIES;
   reg_t expected_tag = addr >> PGSHIFT;
+  host_timer_t timer(proc ? proc->host_profiler : NULL, HOST_TLB_REFILL);
 
   reg_t pgbase;
+  bool walked = false;
   if (unlikely(!proc)) {
     pgbase = addr & -PGSIZE;
   } else {
@@ -49,6 +56,7 @@ void* mmu_t::refill_tlb(reg_t addr, reg_t bytes, bool store, bool fetch)
       pgbase = addr & -PGSIZE & msb_mask;
     } else {
       pgbase = walk(addr, mode > PRV_U, store, fetch);
+      walked = true;
     }
   }
 
@@ -56,16 +64,33 @@ void* mmu_t::refill_tlb(reg_t addr, reg_t bytes, bool store, bool fetch)
   reg_t paddr = pgbase + pgoff;
 
   if (pgbase >= memsz) {
+    page_walks += walked && counting;
     if (fetch) throw trap_instruction_access_fault(addr);
     else if (store) throw trap_store_access_fault(addr);
     else throw trap_load_access_fault(addr);
   }
 
+  if (store && dirty)
+    dirty->mark(pgbase);
+
+  // translations seen by TLB models mustn't be cached in our own TLB
+  bool translate = walked && tracer.interested_in_translation(fetch);
+  if (unlikely(translate) && !(fetch && refetch))
+  {
+    last_walk.vaddr = addr;
+    tracer.translate(last_walk, store, fetch, fetch ? addr : proc->state.pc);
+  }
+
   bool trace = tracer.interested_in_range(pgbase, pgbase + PGSIZE, store, fetch);
   if (unlikely(!fetch && trace))
-    tracer.trace(paddr, bytes, store, fetch);
-  else
+    tracer.trace(paddr, bytes, store, fetch, addr, proc ? proc->state.pc : 0);
+  else if (likely(!translate))
   {
+    // only count what fills the TLB, not the refills of traced accesses,
+    // which are repeated on every access
+    tlb_refills += counting;
+    page_walks += walked && counting;
+
     if (tlb_load_tag[idx] != expected_tag) tlb_load_tag[idx] = -1;
     if (tlb_store_tag[idx] != expected_tag) tlb_store_tag[idx] = -1;
     if (tlb_insn_tag[idx] != expected_tag) tlb_insn_tag[idx] = -1;
@@ -100,6 +125,8 @@ reg_t mmu_t::walk(reg_t addr, bool supervisor, bool store, bool fetch)
 
   reg_t base = proc->get_state()->sptbr;
   int ptshift = (levels - 1) * ptidxbits;
+  last_walk.ptesize = ptesize;
+  last_walk.levels = 0;
   for (int i = 0; i < levels; i++, ptshift -= ptidxbits) {
     reg_t idx = (addr >> (PGSHIFT + ptshift)) & ((1 << ptidxbits) - 1);
 
@@ -107,6 +134,7 @@ reg_t mmu_t::walk(reg_t addr, bool supervisor, bool store, bool fetch)
     reg_t pte_addr = base + idx * ptesize;
     if (pte_addr >= memsz)
       break;
+    last_walk.pte_addr[last_walk.levels++] = pte_addr;
 
     void* ppte = mem + pte_addr;
     reg_t pte = ptesize == 4 ? *(uint32_t*)ppte : *(uint64_t*)ppte;
@@ -118,7 +146,13 @@ reg_t mmu_t::walk(reg_t addr, bool supervisor, bool store, bool fetch)
       break;
     } else {
       // set referenced and possibly dirty bits.
-      *(uint32_t*)ppte |= PTE_R | (store * PTE_D);
+      uint32_t ad = PTE_R | (store * PTE_D);
+      if ((*(uint32_t*)ppte & ad) != ad)
+      {
+        *(uint32_t*)ppte |= ad;
+        if (dirty)
+          dirty->mark(pte_addr);
+      }
       // for superpage mappings, make a fake leaf PTE for the TLB's benefit.
       reg_t vpn = addr >> PGSHIFT;
       reg_t addr = (ppn | (vpn & ((reg_t(1) << ptshift) - 1))) << PGSHIFT;
@@ -127,6 +161,7 @@ reg_t mmu_t::walk(reg_t addr, bool supervisor, bool store, bool fetch)
       if (addr >= memsz)
         break;
 
+      last_walk.pgsize = PGSIZE << ptshift;
       return addr;
     }
   }
@@ -134,8 +169,47 @@ reg_t mmu_t::walk(reg_t addr, bool supervisor, bool store, bool fetch)
   return -1;
 }
 
+void mmu_t::sfence_vm()
+{
+  tracer.flush_translations();
+  flush_tlb();
+}
+
+void mmu_t::load_bytes(reg_t addr, size_t len, void* bytes)
+{
+  for (char* dst = (char*)bytes; len; )
+  {
+    size_t n = std::min<size_t>(len, PGSIZE - addr % PGSIZE);
+    memcpy(dst, translate(addr, 1, false, false), n);
+    addr += n, dst += n, len -= n;
+  }
+}
+
+void mmu_t::store_bytes(reg_t addr, size_t len, const void* bytes)
+{
+  for (const char* src = (const char*)bytes; len; )
+  {
+    size_t n = std::min<size_t>(len, PGSIZE - addr % PGSIZE);
+    memcpy(translate(addr, 1, true, false), src, n);
+    addr += n, src += n, len -= n;
+  }
+}
+
 void mmu_t::register_memtracer(memtracer_t* t)
 {
   flush_tlb();
   tracer.hook(t);
 }
+
+void mmu_t::set_tracing(bool value)
+{
+  flush_tlb();
+  tracer.set_enabled(value);
+}
+
+void mmu_t::register_stats(stats_t* stats, const std::string& prefix)
+{
+  stats->add(prefix + "icache_misses", &icache_misses);
+  stats->add(prefix + "tlb_refills", &tlb_refills);
+  stats->add(prefix + "page_walks", &page_walks);
+}
@@ -10,12 +10,15 @@
 #include "processor.h"
 #include "memtracer.h"
 #include <stdlib.h>
+#include <string>
 #include <vector>
 
 // virtual memory configuration
 #define PGSHIFT 12
 const reg_t PGSIZE = 1 << PGSHIFT;
 
+class dirty_map_t;
+
 struct insn_fetch_t
 {
   insn_func_t func;
@@ -24,7 +27,7 @@ struct insn_fetch_t
 
 struct icache_entry_t {
   reg_t tag;
-  reg_t pad;
+  insn_desc_t* desc;
   insn_fetch_t data;
 };
 
@@ -40,6 +43,8 @@ public:
   #define load_func(type) \
     type##_t load_##type(reg_t addr) __attribute__((always_inline)) { \
       void* paddr = translate(addr, sizeof(type##_t), false, false); \
+      if (unlikely(logging)) \
+        logged_access = true, logged_addr = addr; \
       return *(type##_t*)paddr; \
     }
 
@@ -59,6 +64,8 @@ public:
   #define store_func(type) \
     void store_##type(reg_t addr, type##_t val) { \
       void* paddr = translate(addr, sizeof(type##_t), true, false); \
+      if (unlikely(logging)) \
+        logged_access = true, logged_addr = addr; \
       *(type##_t*)paddr = val; \
     }
 
@@ -68,6 +75,13 @@ public:
   store_func(uint32)
   store_func(uint64)
 
+  // copy len bytes from or to memory at addr, a page at a time
+  void load_bytes(reg_t addr, size_t len, void* bytes);
+  void store_bytes(reg_t addr, size_t len, const void* bytes);
+  // whether len bytes at physical address addr are all in memory, so that
+  // copying them through the debug MMU can't fault
+  bool in_memory(reg_t addr, size_t len) { return addr <= memsz && len <= memsz - addr; }
+
   static const reg_t ICACHE_ENTRIES = 1024;
 
   inline size_t icache_index(reg_t addr)
@@ -105,16 +119,23 @@ public:
       insn |= (insn_bits_t)*(uint16_t*)translate(addr + 2, 1, false, true) << 16;
     }
 
-    insn_fetch_t fetch = {proc->decode_insn(insn), insn};
+    icache_misses += counting;
+    insn_desc_t* desc = proc->decode_insn(insn);
+    insn_fetch_t fetch = {proc->xlen == 64 ? desc->rv64 : desc->rv32, insn};
     icache[idx].tag = addr;
+    icache[idx].desc = desc;
     icache[idx].data = fetch;
 
     reg_t paddr = iaddr - mem;
-    if (!tracer.empty() && tracer.interested_in_range(paddr, paddr + 1, false, true))
+    if (!tracer.empty())
     {
-      icache[idx].tag = -1;
-      tracer.trace(paddr, length, false, true);
+      bool trace = tracer.interested_in_range(paddr, paddr + 1, false, true);
+      if (trace || tracer.interested_in_translation(true))
+        icache[idx].tag = -1;
+      if (trace && !refetch)
+        tracer.trace(paddr, length, false, true, addr, addr);
     }
+    refetch = false;
     return &icache[idx];
   }
 
@@ -127,14 +148,40 @@ public:
 
   void flush_tlb();
   void flush_icache();
+  void sfence_vm(); // an architectural TLB flush, seen by TLB models
+
+  uint64_t get_icache_misses() { return icache_misses; }
+  uint64_t get_tlb_refills() { return tlb_refills; }
+  uint64_t get_page_walks() { return page_walks; }
+  void register_stats(stats_t* stats, const std::string& prefix);
 
   void register_memtracer(memtracer_t*);
+  void set_tracing(bool value); // attach or detach the registered memtracers
+  // the next fetch re-executes an instruction whose fetch has been traced
+  // already, as when a CSR access serializes the simulator
+  void set_refetch() { refetch = !tracer.empty(); }
+  // while logging, loads and stores note their address for the commit log
+  void set_logging(bool value) { logging = value; }
+  void clear_logged_access() { logged_access = false; }
+  bool get_logged_access(reg_t* addr) { *addr = logged_addr; return logged_access; }
+  void set_dirty_map(dirty_map_t* d) { dirty = d; flush_tlb(); }
+  void set_counting(bool value) { counting = value; } // only in the ROI
 
 private:
   char* mem;
   size_t memsz;
   processor_t* proc;
   memtracer_list_t tracer;
+  dirty_map_t* dirty; // pages written to, if tracked
+  bool refetch;
+  bool logging;
+  bool logged_access;
+  reg_t logged_addr;
+
+  bool counting;
+  uint64_t icache_misses;
+  uint64_t tlb_refills;
+  uint64_t page_walks;
 
   // implement an instruction cache for simulator performance
   icache_entry_t icache[ICACHE_ENTRIES];
@@ -151,6 +198,7 @@ private:
 
   // perform a page table walk for a given VA; set referenced/dirty bits
   reg_t walk(reg_t addr, bool supervisor, bool store, bool fetch);
+  translation_t last_walk; // the PTEs read by the most recent walk
 
   // translate a virtual address to a physical address
   void* translate(reg_t addr, reg_t bytes, bool store, bool fetch)
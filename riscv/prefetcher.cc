@@ -0,0 +1,132 @@
+// See LICENSE for license details.
+
+#include "prefetcher.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+static void help()
+{
+  std::cerr << "Prefetcher configurations must be one of" << std::endl;
+  std::cerr << "  next[:degree]" << std::endl;
+  std::cerr << "  stride[:entries[:degree]]" << std::endl;
+  std::cerr << "  stream[:streams[:depth]]" << std::endl;
+  std::cerr << "where entries is a power of two and all fields are positive." << std::endl;
+  exit(1);
+}
+
+prefetcher_t* prefetcher_t::construct(const char* config)
+{
+  const char* p = strchr(config, ':');
+  std::string type(config, p ? p - config : strlen(config));
+
+  size_t args[2] = {0, 0};
+  for (size_t i = 0; i < 2 && p; i++)
+  {
+    args[i] = atoi(++p);
+    if (args[i] == 0)
+      help();
+    p = strchr(p, ':');
+  }
+
+  if (type == "next")
+    return new next_line_prefetcher_t(args[0] ? args[0] : 1);
+  if (type == "stride")
+    return new stride_prefetcher_t(args[0] ? args[0] : 64, args[1] ? args[1] : 2);
+  if (type == "stream")
+    return new stream_prefetcher_t(args[0] ? args[0] : 4, args[1] ? args[1] : 4);
+  help();
+  return NULL;
+}
+
+void next_line_prefetcher_t::observe(uint64_t line, uint64_t pc, bool miss,
+                                     std::vector<uint64_t>& prefetches)
+{
+  if (miss)
+    for (size_t i = 1; i <= degree; i++)
+      prefetches.push_back(line + i);
+}
+
+stride_prefetcher_t::stride_prefetcher_t(size_t entries, size_t degree)
+  : table(entries), degree(degree)
+{
+  if (entries & (entries-1))
+    help();
+  for (auto& e : table)
+    e = (entry_t){uint64_t(-1), 0, 0, 0};
+}
+
+void stride_prefetcher_t::observe(uint64_t line, uint64_t pc, bool miss,
+                                  std::vector<uint64_t>& prefetches)
+{
+  entry_t& e = table[((pc ^ (pc >> 10)) >> 1) & (table.size()-1)];
+  if (e.pc != pc)
+  {
+    e = (entry_t){pc, line, 0, 0};
+    return;
+  }
+
+  int64_t stride = line - e.last_line;
+  if (stride == 0) // another access to the same line
+    return;
+
+  if (stride == e.stride)
+    e.confidence = std::min(e.confidence + 1, 3U);
+  else
+    e.stride = stride, e.confidence = 0;
+  e.last_line = line;
+
+  if (e.confidence > 0)
+    for (size_t i = 1; i <= degree; i++)
+      prefetches.push_back(line + i * e.stride);
+}
+
+stream_prefetcher_t::stream_prefetcher_t(size_t nstreams, size_t depth)
+  : streams(nstreams), depth(depth), now(0), last_miss(-1)
+{
+  for (auto& s : streams)
+    s = (stream_t){uint64_t(-1), 0, 0, 0};
+}
+
+void stream_prefetcher_t::observe(uint64_t line, uint64_t pc, bool miss,
+                                  std::vector<uint64_t>& prefetches)
+{
+  now++;
+
+  stream_t* s = NULL;
+  for (auto& t : streams)
+    if (t.dir != 0 && t.next_line == line)
+      s = &t;
+
+  if (!s)
+  {
+    if (!miss)
+      return;
+
+    // two misses to adjacent lines establish a new stream
+    int dir = line == last_miss + 1 ? 1 : line == last_miss - 1 ? -1 : 0;
+    last_miss = line;
+    if (dir == 0)
+      return;
+
+    s = &streams[0];
+    for (auto& t : streams)
+      if (t.lru < s->lru)
+        s = &t;
+    *s = (stream_t){line, line, dir, 0};
+  }
+
+  s->next_line = line + s->dir;
+  s->lru = now;
+
+  int64_t ahead = int64_t(s->head - line) * s->dir;
+  if (ahead < 0) // the demand stream overtook the prefetches
+    s->head = line, ahead = 0;
+  for ( ; ahead < int64_t(depth); ahead++)
+  {
+    s->head += s->dir;
+    prefetches.push_back(s->head);
+  }
+}
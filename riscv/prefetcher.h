@@ -0,0 +1,82 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_PREFETCHER_H
+#define _RISCV_PREFETCHER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// a hardware prefetcher model that can be attached to any cache_sim_t.
+// it observes the demand stream at cache-line granularity and proposes
+// lines to be brought into the cache.
+class prefetcher_t
+{
+ public:
+  virtual ~prefetcher_t() {}
+
+  // observe a demand access to line number `line`; append lines to prefetch
+  virtual void observe(uint64_t line, uint64_t pc, bool miss,
+                       std::vector<uint64_t>& prefetches) = 0;
+  virtual const char* name() = 0;
+
+  static prefetcher_t* construct(const char* config);
+};
+
+// on every miss, prefetch the next `degree` sequential lines
+class next_line_prefetcher_t : public prefetcher_t
+{
+ public:
+  next_line_prefetcher_t(size_t degree) : degree(degree) {}
+  void observe(uint64_t line, uint64_t pc, bool miss,
+               std::vector<uint64_t>& prefetches);
+  const char* name() { return "next-line"; }
+ private:
+  size_t degree;
+};
+
+// a direct-mapped table indexed by PC detects constant-stride streams
+// and prefetches `degree` strides ahead once the stride repeats
+class stride_prefetcher_t : public prefetcher_t
+{
+ public:
+  stride_prefetcher_t(size_t entries, size_t degree);
+  void observe(uint64_t line, uint64_t pc, bool miss,
+               std::vector<uint64_t>& prefetches);
+  const char* name() { return "stride"; }
+ private:
+  struct entry_t
+  {
+    uint64_t pc;
+    uint64_t last_line;
+    int64_t stride;
+    unsigned confidence;
+  };
+  std::vector<entry_t> table;
+  size_t degree;
+};
+
+// tracks `nstreams` ascending or descending miss streams and keeps each
+// of them `depth` lines ahead of the demand stream
+class stream_prefetcher_t : public prefetcher_t
+{
+ public:
+  stream_prefetcher_t(size_t nstreams, size_t depth);
+  void observe(uint64_t line, uint64_t pc, bool miss,
+               std::vector<uint64_t>& prefetches);
+  const char* name() { return "stream"; }
+ private:
+  struct stream_t
+  {
+    uint64_t next_line; // next line the demand stream should touch
+    uint64_t head;      // furthest line prefetched so far
+    int dir;
+    uint64_t lru;
+  };
+  std::vector<stream_t> streams;
+  size_t depth;
+  uint64_t now;
+  uint64_t last_miss;
+};
+
+#endif
@@ -5,8 +5,16 @@
 #include "common.h"
 #include "config.h"
 #include "sim.h"
-#include "htif.h"
 #include "disasm.h"
+#include "timing.h"
+#include "commitlog.h"
+#include "histogram.h"
+#include "bbv.h"
+#include "profiler.h"
+#include "stats.h"
+#include "hostprof.h"
+#include "flightrec.h"
+#include "checkpoint.h"
 #include <cinttypes>
 #include <cmath>
 #include <cstdlib>
@@ -15,13 +23,30 @@
 #include <limits.h>
 #include <stdexcept>
 #include <algorithm>
+#include <unistd.h>
 
 #undef STATE
 #define STATE state
 
+// region-of-interest markers: the hints slti x0, x0, 1 and slti x0, x0, 2,
+// which are no-ops on hardware, and are only decoded as markers with --roi
+#define MATCH_ROI_BEGIN 0x00102013
+#define MATCH_ROI_END 0x00202013
+#define MASK_ROI 0xffffffff
+
+template<int xlen>
+static reg_t roi_marker(processor_t* p, insn_t insn, reg_t pc)
+{
+  p->mark_roi(insn.bits() == MATCH_ROI_BEGIN);
+  return sext_xlen(pc + 4);
+}
+
 processor_t::processor_t(const char* isa, sim_t* sim, uint32_t id)
   : sim(sim), ext(NULL), disassembler(new disassembler_t),
-    id(id), run(false), debug(false)
+    id(id), run(false), host_wait(false), debug(false), histogram(NULL), histogram_symbols(NULL),
+    bbv(NULL), profiler(NULL), insn_mix(false), timing(NULL), log(NULL), traps(0), roi_instret(0),
+    roi(true), roi_markers(false), end_step(false), host_profiler(NULL),
+    recorder(NULL)
 {
   parse_isa_string(isa);
 
@@ -38,16 +63,24 @@ processor_t::processor_t(const char* isa, sim_t* sim, uint32_t id)
 
 processor_t::~processor_t()
 {
-#ifdef RISCV_ENABLE_HISTOGRAM
-  if (histogram_enabled)
+  char title[32];
+  snprintf(title, sizeof(title), "core %3d:", id);
+  if (histogram)
   {
-    fprintf(stderr, "PC Histogram size:%lu\n", pc_histogram.size());
-    for(auto iterator = pc_histogram.begin(); iterator != pc_histogram.end(); ++iterator) {
-      fprintf(stderr, "%0lx %lu\n", (iterator->first << 2), iterator->second);
-    }
+    histogram->print(stderr, title, histogram_symbols);
+    delete histogram;
   }
-#endif
+  if (profiler)
+    profiler->print(stderr, title);
 
+  if (insn_mix)
+    print_insn_mix(stderr);
+
+  if (timing && state.minstret)
+    fprintf(stderr, "core %3d: %" PRIu64 " cycles, %" PRIu64 " instructions, CPI %.3f\n",
+            id, state.mcycle, state.minstret, double(state.mcycle) / state.minstret);
+
+  delete recorder;
   delete mmu;
   delete disassembler;
 }
@@ -118,15 +151,152 @@ void processor_t::set_debug(bool value)
     ext->set_debug(value);
 }
 
-void processor_t::set_histogram(bool value)
+void processor_t::set_histogram(bool value, const symtab_t* symbols)
+{
+  if (value && !histogram)
+    histogram = new pc_histogram_t;
+  histogram_symbols = symbols;
+}
+
+void processor_t::set_flight_recorder(size_t size)
+{
+  delete recorder;
+  recorder = size ? new flight_recorder_t(size) : NULL;
+}
+
+// formats a flight recorder entry as a line in buf; returns its length
+static size_t describe_entry(char* buf, size_t size, uint32_t id, const flight_recorder_t::entry_t& e)
+{
+  int len;
+  if (e.insns)
+    len = snprintf(buf, size, "core %3d: 0x%016" PRIx64 " %6" PRIu64 " insns, then 0x%016" PRIx64 "\n",
+                   id, e.pc, e.insns, e.next);
+  else
+    len = snprintf(buf, size, "core %3d: 0x%016" PRIx64 " trap, cause 0x%" PRIx64 "\n", id, e.pc, e.next);
+  return std::min<size_t>(std::max(len, 0), size - 1);
+}
+
+void processor_t::print_flight_recorder(FILE* out, size_t n)
+{
+  if (!recorder)
+    return;
+
+  char line[128];
+  size_t size = recorder->size();
+  for (size_t i = size - std::min(n, size); i < size; i++)
+  {
+    describe_entry(line, sizeof(line), id, (*recorder)[i]);
+    fputs(line, out);
+  }
+}
+
+void processor_t::write_flight_recorder(int fd)
 {
-  histogram_enabled = value;
-#ifndef RISCV_ENABLE_HISTOGRAM
-  if (value) {
-    fprintf(stderr, "PC Histogram support has not been properly enabled;");
-    fprintf(stderr, " please re-build the riscv-isa-run project using \"configure --enable-histogram\".\n");
+  if (!recorder)
+    return;
+
+  char line[128];
+  for (size_t i = 0; i < recorder->size(); i++)
+  {
+    size_t len = describe_entry(line, sizeof(line), id, (*recorder)[i]);
+    if (write(fd, line, len) < 0)
+      return;
   }
-#endif
+}
+
+void processor_t::save_state(FILE* f)
+{
+  std::string ext_name = ext ? ext->name() : "";
+  uint64_t ext_name_len = ext_name.size();
+  checkpoint_write(f, &cpuid, sizeof(cpuid));
+  checkpoint_write(f, &ext_name_len, sizeof(ext_name_len));
+  checkpoint_write(f, ext_name.data(), ext_name.size());
+
+  uint64_t state_size = sizeof(state);
+  checkpoint_write(f, &state_size, sizeof(state_size));
+  checkpoint_write(f, &state, sizeof(state));
+  checkpoint_write(f, &xlen, sizeof(xlen));
+  checkpoint_write(f, &run, sizeof(run));
+  checkpoint_write(f, &host_wait, sizeof(host_wait));
+  uint64_t nresponses = responses.size();
+  checkpoint_write(f, &nresponses, sizeof(nresponses));
+  for (reg_t r : responses)
+    checkpoint_write(f, &r, sizeof(r));
+  if (ext)
+    ext->save_state(f);
+}
+
+void processor_t::restore_state(FILE* f)
+{
+  reg_t saved_cpuid;
+  uint64_t ext_name_len;
+  checkpoint_read(f, &saved_cpuid, sizeof(saved_cpuid));
+  checkpoint_read(f, &ext_name_len, sizeof(ext_name_len));
+  std::string ext_name(std::min(ext_name_len, uint64_t(256)), 0);
+  checkpoint_read(f, &ext_name[0], ext_name.size());
+  if (saved_cpuid != cpuid || ext_name != (ext ? ext->name() : ""))
+  {
+    fprintf(stderr, "checkpoint is of a core with a different ISA or extension\n");
+    exit(1);
+  }
+
+  uint64_t state_size;
+  checkpoint_read(f, &state_size, sizeof(state_size));
+  if (state_size != sizeof(state))
+  {
+    fprintf(stderr, "checkpoint is from a different build of the simulator\n");
+    exit(1);
+  }
+  checkpoint_read(f, &state, sizeof(state));
+  checkpoint_read(f, &xlen, sizeof(xlen));
+  checkpoint_read(f, &run, sizeof(run));
+  checkpoint_read(f, &host_wait, sizeof(host_wait));
+  uint64_t nresponses;
+  checkpoint_read(f, &nresponses, sizeof(nresponses));
+  responses.clear();
+  for (uint64_t i = 0; i < nresponses; i++)
+  {
+    reg_t r;
+    checkpoint_read(f, &r, sizeof(r));
+    responses.push_back(r);
+  }
+  if (ext)
+    ext->restore_state(f);
+
+  // discard translations and decoded instructions of the old memory
+  mmu->flush_tlb();
+}
+
+void processor_t::register_stats(stats_t* stats)
+{
+  std::string prefix = "core" + std::to_string(id) + ".";
+  stats->add(prefix + "instret", &roi_instret);
+  if (timing)
+    stats->add(prefix + "cycles", &state.mcycle);
+  stats->add(prefix + "traps", &traps);
+  mmu->register_stats(stats, prefix + "mmu.");
+  if (ext)
+    ext->register_stats(stats, prefix + ext->name() + ".");
+}
+
+void processor_t::set_host_profiler(host_profiler_t* hp)
+{
+  host_profiler = hp;
+  build_opcode_map();
+}
+
+template<int xlen>
+reg_t processor_t::profile_ext_insn(processor_t* p, insn_t insn, reg_t pc)
+{
+  for (auto& desc : p->ext_insns)
+  {
+    if ((insn.bits() & desc.mask) == desc.match)
+    {
+      host_timer_t timer(p->host_profiler, HOST_EXTENSION);
+      return (xlen == 64 ? desc.rv64 : desc.rv32)(p, insn, pc);
+    }
+  }
+  abort();
 }
 
 void processor_t::reset(bool value)
@@ -134,8 +304,12 @@ void processor_t::reset(bool value)
   if (run == !value)
     return;
   run = !value;
+  host_wait = false;
+  responses.clear();
 
   state.reset();
+  if (sim->entry)
+    state.pc = sim->entry;
   set_csr(CSR_MSTATUS, state.mstatus);
 
   if (ext)
@@ -173,42 +347,9 @@ void processor_t::take_interrupt()
   }
 }
 
-static void commit_log(state_t* state, reg_t pc, insn_t insn)
-{
-#ifdef RISCV_ENABLE_COMMITLOG
-  if (get_field(state->mstatus, MSTATUS_IE)) {
-    uint64_t mask = (insn.length() == 8 ? uint64_t(0) : (uint64_t(1) << (insn.length() * 8))) - 1;
-    if (state->log_reg_write.addr) {
-      fprintf(stderr, "0x%016" PRIx64 " (0x%08" PRIx64 ") %c%2" PRIu64 " 0x%016" PRIx64 "\n",
-              pc,
-              insn.bits() & mask,
-              state->log_reg_write.addr & 1 ? 'f' : 'x',
-              state->log_reg_write.addr >> 1,
-              state->log_reg_write.data);
-    } else {
-      fprintf(stderr, "0x%016" PRIx64 " (0x%08" PRIx64 ")\n", pc, insn.bits() & mask);
-    }
-  }
-  state->log_reg_write.addr = 0;
-#endif
-}
-
-inline void processor_t::update_histogram(size_t pc)
-{
-#ifdef RISCV_ENABLE_HISTOGRAM
-  size_t idx = pc >> 2;
-  pc_histogram[idx]++;
-#endif
-}
-
 static reg_t execute_insn(processor_t* p, reg_t pc, insn_fetch_t fetch)
 {
-  reg_t npc = fetch.func(p, fetch.insn, pc);
-  if (npc != PC_SERIALIZE) {
-    commit_log(p->get_state(), pc, fetch.insn);
-    p->update_histogram(pc);
-  }
-  return npc;
+  return fetch.func(p, fetch.insn, pc);
 }
 
 void processor_t::check_timer()
@@ -217,19 +358,63 @@ void processor_t::check_timer()
     state.mip |= MIP_MTIP;
 }
 
-void processor_t::step(size_t n)
+// the registers an instruction may write, and their values before it
+// executes, so that the commit log can find the write without the write
+// macros recording it. a write of the value already there isn't seen.
+struct log_dests_t
+{
+  static const size_t MAX = 7;
+  reg_t dest[MAX]; // as in commit_log_reg_t::addr
+  reg_t old[MAX];
+  size_t n;
+
+  log_dests_t() : n(0) {}
+  static reg_t read(const state_t& s, reg_t d) { return d & 1 ? s.FPR[d >> 1] : s.XPR[d >> 1]; }
+
+  void note(const state_t& s, insn_t insn)
+  {
+    n = 0;
+    dest[n++] = insn.rd() << 1;
+    dest[n++] = insn.rd() << 1 | 1;
+    if (insn.length() == 2)
+    {
+      dest[n++] = insn.rvc_rds() << 1;
+      dest[n++] = insn.rvc_rs1s() << 1;
+      dest[n++] = insn.rvc_rs2s() << 1;
+      dest[n++] = X_RA << 1;
+      dest[n++] = X_SP << 1;
+    }
+    for (size_t i = 0; i < n; i++)
+      old[i] = read(s, dest[i]);
+  }
+
+  commit_log_reg_t written(const state_t& s)
+  {
+    for (size_t i = 0; i < n; i++)
+      if (read(s, dest[i]) != old[i])
+        return (commit_log_reg_t){dest[i], read(s, dest[i])};
+    return (commit_log_reg_t){0, 0};
+  }
+};
+
+size_t processor_t::step(size_t n)
 {
   size_t instret = 0;
   reg_t pc = state.pc;
   mmu_t* _mmu = mmu;
+  bool in_roi = roi; // until a marker ends the step
+  uint64_t stalls = timing ? timing->memory_stalls() : 0; // before this insn
+  reg_t block = pc; // being retired, for the flight recorder
+  size_t block_start = 0; // instret when it began
 
   if (unlikely(!run || !n))
-    return;
+    return 0;
 
   #define maybe_serialize() \
    if (unlikely(pc == PC_SERIALIZE)) { \
      pc = state.pc; \
      state.serialized = true; \
+     _mmu->set_refetch(); \
      break; \
    }
 
@@ -238,23 +423,65 @@ void processor_t::step(size_t n)
     check_timer();
     take_interrupt();
 
-    if (unlikely(debug))
+    // only the slow loop logs: it finds register writes itself, and has
+    // memory accesses note their address only while it runs
+    bool slow = slow_path();
+    end_step = false;
+    _mmu->set_logging(slow && log);
+
+    if (unlikely(slow))
     {
       while (instret < n)
       {
-        insn_fetch_t fetch = mmu->load_insn(pc);
-        if (!state.serialized)
+        block = pc, block_start = instret;
+        if (timing)
+          stalls = timing->memory_stalls();
+        icache_entry_t* ic_entry = mmu->access_icache(pc);
+        insn_fetch_t fetch = ic_entry->data;
+        if (unlikely(debug) && !state.serialized)
           disasm(fetch.insn);
-        pc = execute_insn(this, pc, fetch);
+        log_dests_t dests;
+        if (log)
+        {
+          dests.note(state, fetch.insn);
+          _mmu->clear_logged_access();
+        }
+        reg_t npc = execute_insn(this, pc, fetch);
+        if (npc != PC_SERIALIZE)
+        {
+          if (timing)
+            state.mcycle += timing->cycles(ic_entry->desc->cls, npc != pc + fetch.insn.length())
+                            + timing->memory_stalls() - stalls;
+          if (log)
+          {
+            reg_t addr;
+            bool accessed = _mmu->get_logged_access(&addr);
+            log->log(id, pc, fetch.insn, dests.written(state), accessed ? &addr : NULL);
+          }
+          if (histogram)
+            histogram->add(pc);
+          if (bbv && roi)
+            bbv->retire(pc, npc, fetch.insn.length());
+          if (insn_mix)
+            ic_entry->desc->count++;
+          if (profiler)
+            profiler->retire(pc, npc, fetch.insn, ic_entry->desc);
+          if (recorder)
+            recorder->record(pc, npc, 1);
+        }
+        pc = npc;
         maybe_serialize();
         instret++;
         state.pc = pc;
+        if (unlikely(end_step))
+          break;
       }
     }
     else while (instret < n)
     {
       size_t idx = _mmu->icache_index(pc);
       auto ic_entry = _mmu->access_icache(pc);
+      block = pc, block_start = instret;
 
       #define ICACHE_ACCESS(idx) { \
         insn_fetch_t fetch = ic_entry->data; \
@@ -271,21 +498,51 @@ void processor_t::step(size_t n)
         #include "icache.h"
       }
 
+      if (unlikely(recorder != NULL || bbv != NULL))
+      {
+        // a serializing instruction retires when it's executed again, so
+        // the chain ran on into it. an instruction that flushed the cache
+        // ends a block too.
+        size_t insns = instret - block_start + (pc != PC_SERIALIZE);
+        icache_entry_t* last = ic_entry - 1;
+        bool taken = pc != PC_SERIALIZE && pc != last->tag + last->data.insn.length();
+        if (insns && recorder)
+          recorder->record(block, pc == PC_SERIALIZE ? state.pc : pc, insns);
+        if (insns && bbv && roi)
+          bbv->retire_chain(block, insns, taken);
+      }
       maybe_serialize();
       instret++;
       state.pc = pc;
+      if (unlikely(end_step))
+        break;
     }
   }
   catch(trap_t& t)
   {
+    // a trapping instruction still pays for the accesses it made
+    if (unlikely(timing && roi))
+      state.mcycle += timing->memory_stalls() - stalls;
+    if (unlikely(recorder != NULL))
+    {
+      if (instret > block_start)
+        recorder->record(block, pc, instret - block_start);
+      recorder->record_trap(pc, t.cause());
+    }
+    // the trap ends the block
+    if (unlikely(bbv != NULL) && roi && instret > block_start)
+      bbv->retire_chain(block, instret - block_start, false);
     take_trap(t, pc);
   }
 
   state.minstret += instret;
+  roi_instret += in_roi ? instret : 0;
 
-  // tail-recurse if we didn't execute as many instructions as we'd hoped
-  if (instret < n)
-    step(n - instret);
+  // tail-recurse if we didn't execute as many instructions as we'd hoped,
+  // unless we stopped for the frontend to take a request
+  if (instret < n && !waiting_for_host())
+    instret += step(n - instret);
+  return instret;
 }
 
 void processor_t::push_privilege_stack()
@@ -319,12 +576,63 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     fprintf(stderr, "core %3d: exception %s, epc 0x%016" PRIx64 "\n",
             id, t.name(), epc);
 
+  host_timer_t timer(host_profiler, HOST_TRAP);
+  traps += roi;
+  if (timing && roi)
+    state.mcycle += timing->trap_penalty();
+  if (bbv && roi)
+    bbv->end_block();
+
   state.pc = DEFAULT_MTVEC + 0x40 * get_field(state.mstatus, MSTATUS_PRV);
   push_privilege_stack();
   yield_load_reservation();
   state.mcause = t.cause();
   state.mepc = epc;
   t.side_effects(&state); // might set badvaddr etc.
+
+  if (profiler && roi)
+    profiler->trap(state.pc);
+}
+
+void processor_t::set_roi_markers(bool value)
+{
+  if (value && !roi_markers)
+  {
+    register_insn((insn_desc_t){MATCH_ROI_BEGIN, MASK_ROI, roi_marker<32>, roi_marker<64>, "roi_begin"});
+    register_insn((insn_desc_t){MATCH_ROI_END, MASK_ROI, roi_marker<32>, roi_marker<64>, "roi_end"});
+    build_opcode_map();
+  }
+  roi_markers = value;
+  set_roi(!value);
+}
+
+void processor_t::mark_roi(bool begin)
+{
+  if (roi_markers && begin != roi)
+  {
+    set_roi(begin);
+    // the stepping loop may no longer be the right one: end its chain of
+    // decoded instructions, and have it return once the marker retires
+    end_step = true;
+    mmu->flush_icache();
+  }
+}
+
+void processor_t::set_roi(bool value)
+{
+  if (bbv && !value)
+    bbv->end_block();
+  roi = value;
+  mmu->set_tracing(value && sim->tracing);
+  mmu->set_counting(value);
+}
+
+void processor_t::respond(reg_t val)
+{
+  if (state.fromhost == 0)
+    state.fromhost = val;
+  else
+    responses.push_back(val);
 }
 
 void processor_t::deliver_ipi()
@@ -390,6 +698,16 @@ void processor_t::set_csr(int which, reg_t val)
       state.sutime_delta = (val << 32) | (uint32_t)state.sutime_delta;
       break;
     case CSR_CYCLEW:
+      val -= cycles();
+      if (xlen == 32)
+        state.sucycle_delta = (uint32_t)val | (state.sucycle_delta >> 32 << 32);
+      else
+        state.sucycle_delta = val;
+      break;
+    case CSR_CYCLEHW:
+      val = ((val << 32) - cycles()) >> 32;
+      state.sucycle_delta = (val << 32) | (uint32_t)state.sucycle_delta;
+      break;
     case CSR_INSTRETW:
       val -= state.minstret;
       if (xlen == 32)
@@ -397,7 +715,6 @@ void processor_t::set_csr(int which, reg_t val)
       else
         state.suinstret_delta = val;
       break;
-    case CSR_CYCLEHW:
     case CSR_INSTRETHW:
       val = ((val << 32) - state.minstret) >> 32;
       state.suinstret_delta = (val << 32) | (uint32_t)state.suinstret_delta;
@@ -476,10 +793,23 @@ void processor_t::set_csr(int which, reg_t val)
       break;
     case CSR_SEND_IPI: sim->send_ipi(val); break;
     case CSR_MTOHOST:
-      if (state.tohost == 0)
+      if (state.tohost == 0 && !sim->local_request(this, val))
+      {
         state.tohost = val;
+        host_wait = val != 0;
+        // stop at the end of this chain of decoded instructions, so the
+        // frontend takes the request right away
+        end_step = host_wait;
+      }
+      break;
+    case CSR_MFROMHOST:
+      state.fromhost = val;
+      if (val == 0 && !responses.empty())
+      {
+        state.fromhost = responses.front();
+        responses.pop_front();
+      }
       break;
-    case CSR_MFROMHOST: state.fromhost = val; break;
   }
 }
 
@@ -515,6 +845,7 @@ reg_t processor_t::get_csr(int which)
       return sim->rtc + state.sutime_delta;
     case CSR_CYCLE:
     case CSR_CYCLEW:
+      return cycles() + state.sucycle_delta;
     case CSR_INSTRET:
     case CSR_INSTRETW:
       return state.minstret + state.suinstret_delta;
@@ -524,8 +855,11 @@ reg_t processor_t::get_csr(int which)
         break;
       return (sim->rtc + state.sutime_delta) >> 32;
     case CSR_CYCLEH:
-    case CSR_INSTRETH:
     case CSR_CYCLEHW:
+      if (xlen == 64)
+        break;
+      return (cycles() + state.sucycle_delta) >> 32;
+    case CSR_INSTRETH:
     case CSR_INSTRETHW:
       if (xlen == 64)
         break;
@@ -567,11 +901,10 @@ reg_t processor_t::get_csr(int which)
     case CSR_MHARTID: return id;
     case CSR_MTVEC: return DEFAULT_MTVEC;
     case CSR_MTDELEG: return 0;
-    case CSR_MTOHOST:
-      sim->get_htif()->tick(); // not necessary, but faster
-      return state.tohost;
+    case CSR_MTOHOST: return state.tohost;
     case CSR_MFROMHOST:
-      sim->get_htif()->tick(); // not necessary, but faster
+      if (state.fromhost)
+        host_wait = false;
       return state.fromhost;
     case CSR_SEND_IPI: return 0;
     case CSR_UARCH0:
@@ -590,6 +923,8 @@ reg_t processor_t::get_csr(int which)
     case CSR_UARCH13:
     case CSR_UARCH14:
     case CSR_UARCH15:
+      if (uarch_counters[which - CSR_UARCH0])
+        return uarch_counters[which - CSR_UARCH0]();
       return 0;
   }
   throw trap_illegal_instruction();
@@ -600,7 +935,7 @@ reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc)
   throw trap_illegal_instruction();
 }
 
-insn_func_t processor_t::decode_insn(insn_t insn)
+insn_desc_t* processor_t::decode_insn(insn_t insn)
 {
   size_t mask = opcode_map.size()-1;
   insn_desc_t* desc = opcode_map[insn.bits() & mask]; 
@@ -608,7 +943,55 @@ insn_func_t processor_t::decode_insn(insn_t insn)
   while ((insn.bits() & desc->mask) != desc->match)
     desc++;
 
-  return xlen == 64 ? desc->rv64 : desc->rv32;
+  return desc;
+}
+
+const char* insn_class_name[NUM_INSN_CLASSES] = {
+  "alu", "mul", "div", "load", "store", "amo", "branch", "jump",
+  "fp", "fdiv", "csr", "system", "other"
+};
+
+static insn_class_t classify_insn(const insn_desc_t& d)
+{
+  if (d.mask == 0) // the illegal instruction sentinel
+    return INSN_OTHER;
+
+  if ((d.match & 3) != 3) // RVC
+  {
+    switch (d.match)
+    {
+      case MATCH_C_LD: case MATCH_C_LDSP: case MATCH_C_LW: case MATCH_C_LWSP:
+        return INSN_LOAD;
+      case MATCH_C_SD: case MATCH_C_SDSP: case MATCH_C_SW: case MATCH_C_SWSP:
+        return INSN_STORE;
+      case MATCH_C_BEQZ: case MATCH_C_BNEZ:
+        return INSN_BRANCH;
+      case MATCH_C_J: case MATCH_C_JAL:
+        return INSN_JUMP;
+      default:
+        return INSN_ALU;
+    }
+  }
+
+  uint32_t funct3 = (d.match >> 12) & 7;
+  uint32_t funct7 = d.match >> 25;
+  switch (d.match & 0x7f)
+  {
+    case 0x03: case 0x07: return INSN_LOAD;
+    case 0x23: case 0x27: return INSN_STORE;
+    case 0x2f: return INSN_AMO;
+    case 0x63: return INSN_BRANCH;
+    case 0x67: case 0x6f: return INSN_JUMP;
+    case 0x13: case 0x1b: case 0x17: case 0x37: return INSN_ALU;
+    case 0x33: case 0x3b:
+      return funct7 != 1 ? INSN_ALU : funct3 < 4 ? INSN_MUL : INSN_DIV;
+    case 0x43: case 0x47: case 0x4b: case 0x4f: return INSN_FP;
+    case 0x53:
+      return (funct7 >> 2) == 0x03 || (funct7 >> 2) == 0x0b ? INSN_FDIV : INSN_FP;
+    case 0x73: return funct3 != 0 ? INSN_CSR : INSN_SYSTEM;
+    case 0x0f: return INSN_SYSTEM;
+    default: return INSN_OTHER;
+  }
 }
 
 void processor_t::register_insn(insn_desc_t desc)
@@ -631,6 +1014,9 @@ void processor_t::build_opcode_map()
     bool operator()(const insn_desc_t& lhs, const insn_desc_t& rhs) {
       if ((lhs.match & mask) != (rhs.match & mask))
         return (lhs.match & mask) < (rhs.match & mask);
+      // decode_insn takes the first match, so try exact encodings first
+      if ((lhs.mask == 0xffffffff) != (rhs.mask == 0xffffffff))
+        return lhs.mask == 0xffffffff;
       return lhs.match < rhs.match;
     }
   };
@@ -651,6 +1037,69 @@ void processor_t::build_opcode_map()
   opcode_store[j].match = opcode_store[j].mask = 0;
   opcode_store[j].rv32 = &illegal_instruction;
   opcode_store[j].rv64 = &illegal_instruction;
+  opcode_store[j].name = "illegal";
+
+  for (auto& desc : opcode_store)
+  {
+    desc.cls = classify_insn(desc);
+    desc.count = 0;
+  }
+
+  ext_insns.clear();
+  if (host_profiler)
+  {
+    for (auto& desc : opcode_store)
+    {
+      if (desc.mask && !desc.name)
+      {
+        ext_insns.push_back(desc);
+        desc.rv32 = &profile_ext_insn<32>;
+        desc.rv64 = &profile_ext_insn<64>;
+      }
+    }
+  }
+
+  // decoded instructions point into opcode_store
+  mmu->flush_icache();
+}
+
+void processor_t::print_insn_mix(FILE* out)
+{
+  uint64_t total = 0, rvc = 0, classes[NUM_INSN_CLASSES] = {0};
+  std::vector<const insn_desc_t*> opcodes;
+  for (auto& desc : opcode_store)
+  {
+    if (!desc.count)
+      continue;
+    total += desc.count;
+    classes[desc.cls] += desc.count;
+    if ((desc.match & 3) != 3)
+      rvc += desc.count;
+    opcodes.push_back(&desc);
+  }
+  if (total == 0)
+    return;
+
+  std::sort(opcodes.begin(), opcodes.end(),
+            [](const insn_desc_t* a, const insn_desc_t* b) { return a->count > b->count; });
+
+  auto line = [&](const char* name, uint64_t count) {
+    fprintf(out, "  %-16s %12" PRIu64 " %6.2f%%\n", name, count, 100.0 * count / total);
+  };
+
+  fprintf(out, "core %3d: instruction mix: %" PRIu64 " instructions\n", id, total);
+  for (int i = 0; i < NUM_INSN_CLASSES; i++)
+    if (classes[i])
+      line(insn_class_name[i], classes[i]);
+  line("(compressed)", rvc);
+
+  fprintf(out, "core %3d: opcode mix: %zu opcodes\n", id, opcodes.size());
+  for (auto desc : opcodes)
+  {
+    char custom[32];
+    snprintf(custom, sizeof(custom), "0x%08" PRIx32 "/0x%08" PRIx32, desc->match, desc->mask);
+    line(desc->name ? desc->name : custom, desc->count);
+  }
 }
 
 void processor_t::register_extension(extension_t* x)
@@ -4,9 +4,12 @@
 
 #include "decode.h"
 #include "config.h"
+#include <cstdio>
 #include <cstring>
 #include <vector>
 #include <map>
+#include <deque>
+#include <functional>
 
 class processor_t;
 class mmu_t;
@@ -15,6 +18,36 @@ class sim_t;
 class trap_t;
 class extension_t;
 class disassembler_t;
+class timing_model_t;
+class commit_log_t;
+class pc_histogram_t;
+class bbv_t;
+class profiler_t;
+class symtab_t;
+class stats_t;
+class host_profiler_t;
+class flight_recorder_t;
+
+// coarse instruction categories, for timing and profiling
+enum insn_class_t
+{
+  INSN_ALU,
+  INSN_MUL,
+  INSN_DIV,
+  INSN_LOAD,
+  INSN_STORE,
+  INSN_AMO,
+  INSN_BRANCH,
+  INSN_JUMP,
+  INSN_FP,
+  INSN_FDIV,
+  INSN_CSR,
+  INSN_SYSTEM,
+  INSN_OTHER,
+  NUM_INSN_CLASSES
+};
+
+extern const char* insn_class_name[NUM_INSN_CLASSES];
 
 struct insn_desc_t
 {
@@ -22,11 +55,14 @@ struct insn_desc_t
   uint32_t mask;
   insn_func_t rv32;
   insn_func_t rv64;
+  const char* name; // NULL for extension instructions
+  insn_class_t cls; // filled in by build_opcode_map
+  uint64_t count; // executions, when profiling the instruction mix
 };
 
 struct commit_log_reg_t
 {
-  reg_t addr;
+  reg_t addr; // (register number << 1) | is FP register, or 0 for none
   reg_t data;
 };
 
@@ -47,6 +83,7 @@ struct state_t
   reg_t mscratch;
   reg_t mcause;
   reg_t minstret;
+  reg_t mcycle; // only maintained when a timing model is attached
   reg_t mie;
   reg_t mip;
   reg_t sepc;
@@ -57,6 +94,7 @@ struct state_t
   reg_t scause;
   reg_t sutime_delta;
   reg_t suinstret_delta;
+  reg_t sucycle_delta;
   reg_t tohost;
   reg_t fromhost;
   uint32_t fflags;
@@ -64,10 +102,6 @@ struct state_t
   bool serialized; // whether timer CSRs are in a well-defined state
 
   reg_t load_reservation;
-
-#ifdef RISCV_ENABLE_COMMITLOG
-  commit_log_reg_t log_reg_write;
-#endif
 };
 
 // this class represents one processor in a RISC-V machine.
@@ -78,15 +112,39 @@ public:
   ~processor_t();
 
   void set_debug(bool value);
-  void set_histogram(bool value);
+  void set_histogram(bool value, const symtab_t* symbols);
+  void set_timing_model(timing_model_t* t) { timing = t; }
+  void set_commit_log(commit_log_t* log) { this->log = log; }
+  void set_bbv(bbv_t* b) { bbv = b; }
+  void set_profiler(profiler_t* p) { profiler = p; }
+  void set_insn_mix(bool value) { insn_mix = value; }
+  void set_roi_markers(bool value); // start outside the ROI and obey the guest's markers
+  void mark_roi(bool begin); // executed by the ROI marker instructions
+  void print_insn_mix(FILE* out);
+  void register_stats(stats_t* stats);
+  void set_host_profiler(host_profiler_t* hp);
+  void set_flight_recorder(size_t size); // record the last size blocks and traps
+  void print_flight_recorder(FILE* out, size_t n); // the last n of them
+  // all of them, with write(2) rather than stdio, for a signal handler
+  void write_flight_recorder(int fd);
+  void save_state(FILE* f); // to a checkpoint
+  void restore_state(FILE* f);
   void reset(bool value);
-  void step(size_t n); // run for n cycles
+  size_t step(size_t n); // run for n cycles; returns the instructions retired
   void deliver_ipi(); // register an interprocessor interrupt
   bool running() { return run; }
+  // deliver a device's response in fromhost, once the guest has taken the
+  // responses before it
+  void respond(reg_t val);
+  // the guest wrote a request to tohost that the frontend hasn't yet taken
+  bool waiting_for_host() { return host_wait && state.tohost; }
   void set_csr(int which, reg_t val);
   void raise_interrupt(reg_t which);
   reg_t get_csr(int which);
   mmu_t* get_mmu() { return mmu; }
+  uint64_t get_traps() { return traps; }
+  // let the guest read a simulator counter through CSR_UARCH0 + n
+  void set_uarch_counter(size_t n, std::function<reg_t()> counter) { uarch_counters[n] = counter; }
   state_t* get_state() { return &state; }
   extension_t* get_extension() { return ext; }
   bool supports_extension(unsigned char ext) {
@@ -95,7 +153,6 @@ public:
   void push_privilege_stack();
   void pop_privilege_stack();
   void yield_load_reservation() { state.load_reservation = (reg_t)-1; }
-  void update_histogram(size_t pc);
 
   void register_insn(insn_desc_t);
   void register_extension(extension_t*);
@@ -111,18 +168,42 @@ private:
   int max_xlen;
   int xlen;
   bool run; // !reset
+  bool host_wait;
+  std::deque<reg_t> responses; // waiting for fromhost
   bool debug;
-  bool histogram_enabled;
+  pc_histogram_t* histogram;
+  const symtab_t* histogram_symbols;
+  bbv_t* bbv;
+  profiler_t* profiler;
+  bool insn_mix;
+  timing_model_t* timing;
+  commit_log_t* log;
+  uint64_t traps; // inside the ROI, like roi_instret
+  uint64_t roi_instret; // retired inside the ROI
+  bool roi; // inside the region of interest
+  bool roi_markers;
+  bool end_step; // once this instruction retires: by an ROI marker or a request
+  host_profiler_t* host_profiler;
+  flight_recorder_t* recorder;
+  std::function<reg_t()> uarch_counters[16];
 
   std::vector<insn_desc_t> instructions;
   std::vector<insn_desc_t*> opcode_map;
   std::vector<insn_desc_t> opcode_store;
-  std::map<size_t,size_t> pc_histogram;
+  std::vector<insn_desc_t> ext_insns; // unwrapped, when host profiling
+
+  // times an extension instruction, then executes it
+  template<int xlen>
+  static reg_t profile_ext_insn(processor_t* p, insn_t insn, reg_t pc);
 
   void check_timer();
   void take_interrupt(); // take a trap if any interrupts are pending
   void take_trap(trap_t& t, reg_t epc); // take an exception
   void disasm(insn_t insn); // disassemble and print an instruction
+  reg_t cycles() { return timing ? state.mcycle : state.minstret; }
+  // instrumentation runs in a separate, slower stepping loop
+  bool slow_path() { return debug || (roi && (timing || log || histogram || profiler || insn_mix)); }
+  void set_roi(bool value);
 
   friend class sim_t;
   friend class mmu_t;
@@ -130,7 +211,7 @@ private:
 
   void parse_isa_string(const char* isa);
   void build_opcode_map();
-  insn_func_t decode_insn(insn_t insn);
+  insn_desc_t* decode_insn(insn_t insn);
 };
 
 reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc);
@@ -138,6 +219,6 @@ reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc);
 #define REGISTER_INSN(proc, name, match, mask) \
   extern reg_t rv32_##name(processor_t*, insn_t, reg_t); \
   extern reg_t rv64_##name(processor_t*, insn_t, reg_t); \
-  proc->register_insn((insn_desc_t){match, mask, rv32_##name, rv64_##name});
+  proc->register_insn((insn_desc_t){match, mask, rv32_##name, rv64_##name, #name});
 
 #endif
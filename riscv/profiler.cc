@@ -0,0 +1,117 @@
+// See LICENSE for license details.
+
+#include "profiler.h"
+#include "symtab.h"
+#include <cinttypes>
+#include <cstdlib>
+#include <algorithm>
+
+profiler_t::profiler_t(const char* filename, uint64_t period, const symtab_t* symbols)
+  : period(period), until_sample(period), samples(0), symbols(symbols)
+{
+  file = fopen(filename, "w");
+  if (!file)
+  {
+    fprintf(stderr, "couldn't open profile %s\n", filename);
+    exit(1);
+  }
+}
+
+profiler_t::~profiler_t()
+{
+  for (auto& f : folded)
+    fprintf(file, "%s %" PRIu64 "\n", f.first.c_str(), f.second);
+  fclose(file);
+}
+
+static bool is_link(uint64_t reg)
+{
+  return reg == X_RA || reg == 5; // ra or the alternate link register t0
+}
+
+void profiler_t::track(reg_t npc, insn_t insn, const insn_desc_t* desc)
+{
+  if (desc->match == MATCH_SRET)
+  {
+    // unwind whatever the trap handler left on the stack
+    while (!stack.empty())
+    {
+      bool trap = stack.back().trap;
+      stack.pop_back();
+      if (trap)
+        break;
+    }
+  }
+  else if (desc->match == MATCH_C_JAL)
+    push(npc, false);
+  else if ((desc->match & 0x7f) == 0x6f) // jal
+  {
+    if (is_link(insn.rd()))
+      push(npc, false);
+  }
+  else if ((desc->match & 0x7f) == 0x67) // jalr
+  {
+    if (is_link(insn.rd()))
+      push(npc, false);
+    else if (insn.rd() == 0 && is_link(insn.rs1()) && !stack.empty() && !stack.back().trap)
+      stack.pop_back();
+  }
+}
+
+void profiler_t::push(reg_t entry, bool trap)
+{
+  // runaway recursion or unmatched calls (e.g. longjmp) shouldn't grow
+  // the stack without bound; forget the outermost frame instead
+  if (stack.size() == MAX_DEPTH)
+    stack.erase(stack.begin());
+  stack.push_back((frame_t){entry, trap});
+}
+
+std::string profiler_t::name(reg_t pc)
+{
+  const symbol_t* s = symbols ? symbols->lookup(pc) : NULL;
+  if (s)
+    return s->name;
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "0x%" PRIx64, pc);
+  return buf;
+}
+
+void profiler_t::sample(reg_t pc)
+{
+  until_sample = period;
+  samples++;
+
+  std::string leaf = name(pc);
+  std::string stack_names, last;
+  for (auto& f : stack)
+  {
+    last = name(f.entry);
+    stack_names += last + ';';
+  }
+  if (last == leaf)
+    stack_names.resize(stack_names.size() - 1);
+  else
+    stack_names += leaf;
+
+  folded[stack_names]++;
+  self[leaf]++;
+}
+
+void profiler_t::print(FILE* out, const char* title)
+{
+  if (samples == 0)
+    return;
+
+  std::vector<std::pair<std::string, uint64_t>> funcs(self.begin(), self.end());
+  std::sort(funcs.begin(), funcs.end(),
+            [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) {
+              return a.second > b.second;
+            });
+
+  fprintf(out, "%s profile: %" PRIu64 " samples, one per %" PRIu64 " instructions\n",
+          title, samples, period);
+  for (auto& f : funcs)
+    fprintf(out, "%12" PRIu64 " %6.2f%% %s\n", f.second, 100.0 * f.second / samples, f.first.c_str());
+}
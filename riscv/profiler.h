@@ -0,0 +1,60 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_PROFILER_H
+#define _RISCV_PROFILER_H
+
+#include "processor.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+class symtab_t;
+
+// samples a hart's PC every `period` instructions and attributes each
+// sample to the function it hit and to the call stack leading there. the
+// call stack is a shadow stack maintained by watching for calls and
+// returns through ra, and for traps and returns from them.
+class profiler_t
+{
+ public:
+  profiler_t(const char* filename, uint64_t period, const symtab_t* symbols);
+  ~profiler_t(); // writes the folded stacks
+
+  void retire(reg_t pc, reg_t npc, insn_t insn, const insn_desc_t* desc)
+  {
+    if (unlikely(--until_sample == 0))
+      sample(pc);
+    if (unlikely(desc->cls == INSN_JUMP || desc->match == MATCH_SRET))
+      track(npc, insn, desc);
+  }
+  void trap(reg_t handler) { push(handler, true); }
+
+  // the functions with the most samples, with their share of samples
+  void print(FILE* out, const char* title);
+
+ private:
+  static const size_t MAX_DEPTH = 1024;
+
+  struct frame_t
+  {
+    reg_t entry;
+    bool trap;
+  };
+
+  FILE* file;
+  uint64_t period;
+  uint64_t until_sample;
+  uint64_t samples;
+  const symtab_t* symbols;
+  std::vector<frame_t> stack;
+  std::map<std::string, uint64_t> folded;
+  std::map<std::string, uint64_t> self;
+
+  void track(reg_t npc, insn_t insn, const insn_desc_t* desc);
+  void push(reg_t entry, bool trap);
+  void sample(reg_t pc);
+  std::string name(reg_t pc);
+};
+
+#endif
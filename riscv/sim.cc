@@ -2,12 +2,20 @@
 
 #include "sim.h"
 #include "htif.h"
+#include "cachesim.h"
+#include "stats.h"
+#include "hostprof.h"
+#include "elfload.h"
+#include "localdev.h"
 #include <map>
 #include <iostream>
 #include <climits>
 #include <cstdlib>
 #include <cassert>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 volatile bool ctrlc_pressed = false;
 static void handle_signal(int sig)
@@ -18,10 +26,37 @@ static void handle_signal(int sig)
   signal(sig, &handle_signal);
 }
 
+sim_t* sim_t::recorded = NULL;
+
+void sim_t::print_recorded()
+{
+  if (recorded)
+    recorded->print_flight_recorders(stderr);
+}
+
+void sim_t::write_recorded()
+{
+  if (recorded)
+    for (size_t i = 0; i < recorded->procs.size(); i++)
+      recorded->procs[i]->write_flight_recorder(STDERR_FILENO);
+}
+
+static void handle_fatal_signal(int sig)
+{
+  signal(sig, SIG_DFL);
+  sim_t::write_recorded();
+  raise(sig);
+}
+
 sim_t::sim_t(const char* isa, size_t nprocs, size_t mem_mb,
-             const std::vector<std::string>& args)
-  : htif(new htif_isasim_t(this, args)), procs(std::max(nprocs, size_t(1))),
-    rtc(0), current_step(0), current_proc(0), debug(false)
+             const std::vector<std::string>& args, bool inproc_frontend)
+  : htif(inproc_frontend ? (htif_port_t*)new htif_inproc_t(this, args)
+                         : (htif_port_t*)new htif_isasim_t(this, args)),
+    procs(std::max(nprocs, size_t(1))),
+    sampler(NULL), stats(NULL), host_profiler(NULL),
+    checkpoint_left(0), checkpoint_interval(0), checkpoints(0),
+    fast_forward_left(procs.size()), direct_load(false), entry(0), fork_period(0), fork_window(0), fork_jobs(0), fork_left(0),
+    fork_children(0), fork_samples(0), sample_child(false), sample_done(false), tracing(true), rtc(0), current_step(0), current_proc(0), debug(false)
 {
   signal(SIGINT, &handle_signal);
   // allocate target machine's memory, shrinking it as necessary
@@ -31,8 +66,11 @@ sim_t::sim_t(const char* isa, size_t nprocs, size_t mem_mb,
   if (memsz0 == 0)
     memsz0 = 1L << (sizeof(size_t) == 8 ? 32 : 30);
 
+  // map memory rather than allocate it, so that a checkpoint's memory
+  // image can be mapped over it
   memsz = memsz0;
-  while ((mem = (char*)calloc(1, memsz)) == NULL)
+  while ((mem = (char*)mmap(NULL, memsz, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) == MAP_FAILED)
     memsz = memsz*10/11/quantum*quantum;
 
   if (memsz != memsz0)
@@ -43,6 +81,11 @@ sim_t::sim_t(const char* isa, size_t nprocs, size_t mem_mb,
 
   for (size_t i = 0; i < procs.size(); i++)
     procs[i] = new processor_t(isa, this, i);
+
+  dirty_pages.reset(new dirty_map_t(memsz));
+  debug_mmu->set_dirty_map(dirty_pages.get());
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->get_mmu()->set_dirty_map(dirty_pages.get());
 }
 
 sim_t::~sim_t()
@@ -50,7 +93,12 @@ sim_t::~sim_t()
   for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
   delete debug_mmu;
-  free(mem);
+  munmap(mem, memsz);
+  if (recorded == this)
+    recorded = NULL;
+  // the frontend's thread wasn't forked, so leave its connection alone
+  if (sample_child)
+    htif.release();
 }
 
 void sim_t::send_ipi(reg_t who)
@@ -71,22 +119,71 @@ reg_t sim_t::get_scr(int which)
 
 int sim_t::run()
 {
-  while (htif->tick())
+  int exit_code = htif->serve();
+
+  if (sample_child)
+    return 0;
+  while (fork_children && wait(NULL) > 0)
+    fork_children--;
+  return exit_code;
+}
+
+void sim_t::run_quantum()
+{
+  if (!restore_file.empty())
+  {
+    restore_checkpoint(restore_file.c_str());
+    restore_file.clear();
+  }
+  if ((debug && !fast_forwarding()) || ctrlc_pressed)
   {
-    if (debug || ctrlc_pressed)
-      interactive();
-    else
-      step(INTERLEAVE);
+    if (ctrlc_pressed)
+      print_flight_recorders(stderr);
+    interactive();
   }
-  return htif->exit_code();
+  else
+    step(INTERLEAVE);
 }
 
 void sim_t::step(size_t n)
 {
-  for (size_t i = 0, steps = 0; i < n; i += steps)
+  for (size_t i = 0, steps = 0; i < n && !sample_done; i += steps)
   {
     steps = std::min(n - i, INTERLEAVE - current_step);
-    procs[current_proc]->step(steps);
+    if (sampler)
+      steps = std::min(steps, sampler->remaining());
+    if (stats)
+      steps = std::min(steps, stats->remaining());
+    if (checkpoint_left)
+      steps = std::min(steps, checkpoint_left);
+    if (fork_left)
+      steps = std::min(steps, fork_left);
+    size_t& fast_forward = fast_forward_left[current_proc];
+    if (fast_forward)
+      steps = std::min(steps, fast_forward);
+    size_t retired;
+    {
+      host_timer_t timer(host_profiler, HOST_DISPATCH);
+      retired = procs[current_proc]->step(steps);
+    }
+    // the core stopped early to wait for the frontend
+    bool host_wait = retired < steps && procs[current_proc]->waiting_for_host();
+    if (host_wait)
+      steps = retired;
+    if (host_wait && sample_child)
+    {
+      // the frontend stayed with the parent, so it will never answer; what
+      // follows would just be the core waiting, so end the window here
+      fprintf(stderr, "sample ended early: core %d waits for the host\n", int(current_proc));
+      sample_done = true;
+    }
+    if (fast_forward && (fast_forward -= steps) == 0)
+      procs[current_proc]->set_roi(true);
+
+    if (sampler && sampler->advance(steps))
+      set_tracing(sampler->tracing());
+    if (stats && stats->advance(steps))
+      stats->dump();
 
     current_step += steps;
     if (current_step == INTERLEAVE)
@@ -98,11 +195,95 @@ void sim_t::step(size_t n)
         rtc += INTERLEAVE / INSNS_PER_RTC_TICK;
       }
 
+      tick_devices();
       htif->tick();
     }
+
+    if (checkpoint_left && (checkpoint_left -= steps) == 0)
+    {
+      if (devices_busy())
+        checkpoint_left = INTERLEAVE; // try again once they've responded
+      else
+      {
+        std::string name = checkpoint_file;
+        std::string parent = checkpoint_file;
+        if (checkpoints)
+          name += "." + std::to_string(checkpoints);
+        if (checkpoints > 1)
+          parent += "." + std::to_string(checkpoints - 1);
+        save_checkpoint(name.c_str(), checkpoints ? parent.c_str() : NULL);
+        clear_dirty_pages();
+        checkpoints++;
+        checkpoint_left = checkpoint_interval;
+      }
+    }
+    if (fork_left && (fork_left -= steps) == 0)
+    {
+      if (sample_child)
+        sample_done = true;
+      else
+        fork_sample();
+    }
+    if (host_wait)
+    {
+      // end the quantum, so the request is serviced now rather than at
+      // the next interleave
+      tick_devices();
+      htif->tick();
+      return;
+    }
   }
 }
 
+void sim_t::set_fork_sampling(size_t period, size_t window, size_t jobs,
+                              std::function<void(size_t)> on_fork)
+{
+  fork_period = period;
+  fork_window = window;
+  fork_jobs = jobs;
+  fork_left = period;
+  this->on_fork = on_fork;
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_roi(false);
+}
+
+void sim_t::fork_sample()
+{
+  while (fork_children >= fork_jobs && wait(NULL) > 0)
+    fork_children--;
+
+  // don't let the child inherit buffered output
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    fprintf(stderr, "couldn't fork sample %d\n", int(fork_samples));
+    exit(1);
+  }
+
+  size_t sample = fork_samples++;
+  if (pid)
+  {
+    fork_children++;
+    fork_left = fork_period;
+    return;
+  }
+
+  sample_child = true;
+  fork_children = 0;
+  fork_left = fork_window;
+  checkpoint_left = 0; // the parent takes them
+  signal(SIGINT, SIG_IGN);
+  for (auto& dev : devices)
+    dev.second->detach();
+  if (on_fork)
+    on_fork(sample);
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_roi(true);
+}
+
 bool sim_t::running()
 {
   for (size_t i = 0; i < procs.size(); i++)
@@ -123,14 +304,152 @@ void sim_t::set_debug(bool value)
   debug = value;
 }
 
-void sim_t::set_histogram(bool value)
+void sim_t::set_histogram(bool value, const symtab_t* symbols)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_histogram(value, symbols);
+}
+
+void sim_t::set_tracing(bool value)
 {
-  histogram_enabled = value;
-  for (size_t i = 0; i < procs.size(); i++) {
-    procs[i]->set_histogram(histogram_enabled);
+  tracing = value;
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->get_mmu()->set_tracing(value && procs[i]->roi);
+}
+
+void sim_t::set_flight_recorder(size_t size)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_flight_recorder(size);
+
+  // print them if the simulator dies: on exit() before the run finishes,
+  // and on fatal signals, including the abort of an uncaught exception
+  if (size && !recorded)
+  {
+    recorded = this;
+    atexit(&print_recorded);
+    for (int sig : {SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL})
+      signal(sig, &handle_fatal_signal);
   }
 }
 
+void sim_t::print_flight_recorders(FILE* out)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->print_flight_recorder(out, SIZE_MAX);
+}
+
+bool sim_t::load_elf(const char* filename)
+{
+  // memory hasn't been touched since it was mapped, so the bss is zero
+  return load_elf_segments(filename, mem, memsz, &entry);
+}
+
+bool sim_t::local_request(processor_t* p, reg_t tohost)
+{
+  auto it = devices.find(tohost >> 56);
+  if (it == devices.end())
+    return false;
+
+  reg_t resp;
+  uint8_t cmd = tohost >> 48;
+  if (it->second->handle(p, debug_mmu, cmd, tohost << 16 >> 16, &resp))
+    p->respond((tohost >> 48 << 48) | (resp << 16 >> 16));
+  return true;
+}
+
+void sim_t::tick_devices()
+{
+  for (auto& dev : devices)
+    dev.second->tick();
+}
+
+bool sim_t::devices_busy()
+{
+  for (auto& dev : devices)
+    if (dev.second->busy())
+      return true;
+  return false;
+}
+
+void sim_t::set_checkpoint(const char* filename, size_t insns, size_t interval)
+{
+  checkpoint_file = filename;
+  checkpoint_left = insns;
+  checkpoint_interval = interval;
+}
+
+void sim_t::clear_dirty_pages()
+{
+  dirty_pages->clear();
+  debug_mmu->flush_tlb();
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->get_mmu()->flush_tlb();
+}
+
+void sim_t::set_roi_markers(bool value)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_roi_markers(value);
+}
+
+void sim_t::set_fast_forward(size_t insns)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+  {
+    fast_forward_left[i] = insns;
+    if (insns)
+      procs[i]->set_roi(false);
+  }
+}
+
+bool sim_t::fast_forwarding()
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    if (fast_forward_left[i])
+      return true;
+  return false;
+}
+
+void sim_t::set_cache_sampler(cache_sampler_t* s)
+{
+  sampler = s;
+  set_tracing(sampler->tracing());
+}
+
+void sim_t::set_host_profiler(host_profiler_t* hp)
+{
+  host_profiler = hp;
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_host_profiler(hp);
+}
+
+void sim_t::set_stats(stats_t* s)
+{
+  stats = s;
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->register_stats(stats);
+  htif->register_stats(stats);
+}
+
+void sim_t::set_timing_model(timing_model_t* t)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_timing_model(t);
+}
+
+void sim_t::set_commit_log(commit_log_t* log)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_commit_log(log);
+}
+
+void sim_t::set_insn_mix(bool value)
+{
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->set_insn_mix(value);
+}
+
 void sim_t::set_procs_debug(bool value)
 {
   for (size_t i=0; i< procs.size(); i++)
@@ -6,17 +6,26 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <functional>
+#include <map>
 #include "processor.h"
 #include "mmu.h"
+#include "dirtymap.h"
 
-class htif_isasim_t;
+class htif_port_t;
+class cache_sampler_t;
+class symtab_t;
+class stats_t;
+class host_profiler_t;
+class local_device_t;
 
 // this class encapsulates the processors and memory in a RISC-V machine.
 class sim_t
 {
 public:
+  // the frontend runs on its own thread, unless inproc_frontend is set
   sim_t(const char* isa, size_t _nprocs, size_t mem_mb,
-        const std::vector<std::string>& htif_args);
+        const std::vector<std::string>& htif_args, bool inproc_frontend = false);
   ~sim_t();
 
   // run the simulation to completion
@@ -24,9 +33,54 @@ public:
   bool running();
   void stop();
   void set_debug(bool value);
-  void set_histogram(bool value);
+  void set_histogram(bool value, const symtab_t* symbols);
   void set_procs_debug(bool value);
-  htif_isasim_t* get_htif() { return htif.get(); }
+  void set_tracing(bool value);
+  void set_cache_sampler(cache_sampler_t* s);
+  void set_timing_model(timing_model_t* t);
+  void set_commit_log(commit_log_t* log);
+  void set_insn_mix(bool value);
+  void set_roi_markers(bool value);
+  // run each core's first insns instructions with the instrumentation
+  // detached, then attach it
+  void set_fast_forward(size_t insns);
+  void set_flight_recorder(size_t size);
+  void print_flight_recorders(FILE* out);
+  static void print_recorded(); // the flight recorders of the one being run
+  // the same from a signal handler, which mustn't use stdio: the signal
+  // may have interrupted it, holding its locks
+  static void write_recorded();
+  // save a full checkpoint or, if parent is given, only the pages written
+  // since the last checkpoint, which was saved to parent
+  void save_checkpoint(const char* filename, const char* parent = NULL);
+  // whether a local device has yet to respond to a request, which a
+  // checkpoint can't hold
+  bool devices_busy();
+  void restore_checkpoint(const char* filename);
+  // save a checkpoint to filename once insns instructions have run, and
+  // then, if interval is nonzero, an incremental one to filename.<k> every
+  // interval instructions
+  void set_checkpoint(const char* filename, size_t insns, size_t interval);
+  // the pages of memory written to since the last clear_dirty_pages
+  dirty_map_t* get_dirty_map() { return dirty_pages.get(); }
+  void clear_dirty_pages();
+  // load the target program's segments straight into memory and start the
+  // cores at its entry point, rather than have the frontend load it
+  void set_direct_load(bool value) { direct_load = value; }
+  // restore a checkpoint once the frontend has reset the machine
+  void set_restore(const char* filename) { restore_file = filename; }
+  // every period instructions, fork a child that simulates the next window
+  // instructions with instrumentation attached, while this process runs
+  // on without it. at most jobs children run at once. each child calls
+  // on_fork with its sample number first. the frontend stays with the
+  // parent, so a child's window ends early if a core waits for the host.
+  void set_fork_sampling(size_t period, size_t window, size_t jobs,
+                         std::function<void(size_t)> on_fork);
+  // serve HTIF device n's commands in the simulator, not the frontend
+  void register_device(uint8_t n, local_device_t* dev) { devices[n] = dev; }
+  void set_host_profiler(host_profiler_t* hp);
+  void set_stats(stats_t* s); // registers the cores and htif, which must come first
+  htif_port_t* get_htif() { return htif.get(); }
 
   // deliver an IPI to a specific processor
   void send_ipi(reg_t who);
@@ -39,21 +93,51 @@ public:
   reg_t get_scr(int which);
 
 private:
-  std::unique_ptr<htif_isasim_t> htif;
+  std::unique_ptr<htif_port_t> htif;
   char* mem; // main memory
   size_t memsz; // memory size in bytes
   mmu_t* debug_mmu;  // debug port into main memory
   std::vector<processor_t*> procs;
+  cache_sampler_t* sampler;
+  stats_t* stats;
+  host_profiler_t* host_profiler;
+  std::string checkpoint_file;
+  size_t checkpoint_left; // instructions until the checkpoint is saved
+  size_t checkpoint_interval;
+  size_t checkpoints; // saved so far
+  std::unique_ptr<dirty_map_t> dirty_pages;
+  std::vector<size_t> fast_forward_left; // per core
+  std::string restore_file;
+  std::map<uint8_t, local_device_t*> devices;
+  bool direct_load;
+  reg_t entry; // where the cores start, if the program was loaded directly
+  size_t fork_period;
+  size_t fork_window;
+  size_t fork_jobs;
+  size_t fork_left; // instructions until the next fork, or the window's end
+  size_t fork_children; // running
+  size_t fork_samples; // forked so far
+  std::function<void(size_t)> on_fork;
+  bool sample_child;
+  bool sample_done;
+  bool tracing; // memtracers attached, unless a core is outside its ROI
+  static sim_t* recorded; // with flight recorders, until it's destroyed
 
   processor_t* get_core(const std::string& i);
   void step(size_t n); // step through simulation
+  void run_quantum(); // between services of the frontend
+  void fork_sample();
+  bool fast_forwarding();
+  bool load_elf(const char* filename); // false if it can't be opened
+  // serve a tohost request if it's for a local device, responding to p
+  bool local_request(processor_t* p, reg_t tohost);
+  void tick_devices();
   static const size_t INTERLEAVE = 5000;
   static const size_t INSNS_PER_RTC_TICK = 100; // 10 MHz clock for 1 BIPS core
   reg_t rtc;
   size_t current_step;
   size_t current_proc;
   bool debug;
-  bool histogram_enabled; // provide a histogram of PCs
 
   // presents a prompt for introspection into the simulation
   void interactive();
@@ -71,13 +155,18 @@ private:
   void interactive_mem(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_str(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_until(const std::string& cmd, const std::vector<std::string>& args);
+  void interactive_mix(const std::string& cmd, const std::vector<std::string>& args);
+  void interactive_history(const std::string& cmd, const std::vector<std::string>& args);
+  void interactive_checkpoint(const std::string& cmd, const std::vector<std::string>& args);
   reg_t get_reg(const std::vector<std::string>& args);
   reg_t get_freg(const std::vector<std::string>& args);
   reg_t get_mem(const std::vector<std::string>& args);
   reg_t get_pc(const std::vector<std::string>& args);
   reg_t get_tohost(const std::vector<std::string>& args);
 
+  friend class htif_port_t;
   friend class htif_isasim_t;
+  friend class htif_inproc_t;
   friend class processor_t;
 };
 
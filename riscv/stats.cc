@@ -0,0 +1,90 @@
+// See LICENSE for license details.
+
+#include "stats.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+
+std::vector<stats_t*> stats_t::live;
+
+stats_t::stats_t(const char* filename, uint64_t interval)
+  : interval(interval), left(interval)
+{
+  open(filename);
+  if (live.empty())
+    atexit(dump_all);
+  live.push_back(this);
+}
+
+void stats_t::dump_all()
+{
+  for (auto stats : live)
+    stats->dump();
+}
+
+void stats_t::reopen(const char* filename)
+{
+  fclose(file);
+  open(filename);
+}
+
+void stats_t::open(const char* filename)
+{
+  file = fopen(filename, "w");
+  if (!file)
+  {
+    fprintf(stderr, "couldn't open stats file %s\n", filename);
+    exit(1);
+  }
+}
+
+stats_t::~stats_t()
+{
+  live.erase(std::find(live.begin(), live.end(), this));
+  dump();
+  fclose(file);
+}
+
+void stats_t::add(const std::string& name, const uint64_t* counter)
+{
+  counters.push_back(std::make_pair(name, counter));
+}
+
+bool stats_t::advance(size_t n)
+{
+  if (!interval)
+    return false;
+
+  left -= n;
+  if (left)
+    return false;
+
+  left = interval;
+  return true;
+}
+
+static void print_json_string(FILE* file, const std::string& s)
+{
+  fputc('"', file);
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+void stats_t::dump()
+{
+  fputc('{', file);
+  for (size_t i = 0; i < counters.size(); i++)
+  {
+    if (i)
+      fputs(", ", file);
+    print_json_string(file, counters[i].first);
+    fprintf(file, ": %" PRIu64, *counters[i].second);
+  }
+  fputs("}\n", file);
+  fflush(file);
+}
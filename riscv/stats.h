@@ -0,0 +1,46 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_STATS_H
+#define _RISCV_STATS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// a registry of named counters, which subsystems register into. each dump
+// writes one JSON object mapping every counter's name to its current value
+// on a line of its own: every interval instructions, if interval is nonzero,
+// and once more at the end of the run, which is when the registry is
+// destroyed or, if the simulator exits early, at exit.
+class stats_t
+{
+ public:
+  stats_t(const char* filename, uint64_t interval);
+  ~stats_t();
+
+  // dump to filename from now on
+  void reopen(const char* filename);
+
+  // the counter must outlive the final dump
+  void add(const std::string& name, const uint64_t* counter);
+  void dump();
+
+  // account for n retired instructions; returns true if a dump is due
+  bool advance(size_t n);
+  // instructions left before the next dump
+  size_t remaining() { return interval ? left : SIZE_MAX; }
+
+ private:
+  void open(const char* filename);
+
+  static std::vector<stats_t*> live; // dumped at exit
+  static void dump_all();
+
+  FILE* file;
+  uint64_t interval;
+  uint64_t left;
+  std::vector<std::pair<std::string, const uint64_t*>> counters;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// See LICENSE for license details.
+
+#include "symtab.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+symtab_t::symtab_t(const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat s;
+  if (fd < 0 || fstat(fd, &s) < 0)
+  {
+    fprintf(stderr, "warning: couldn't read symbols from %s\n", filename);
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+
+  size_t size = s.st_size;
+  void* buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED)
+    return;
+
+  const char* ident = (const char*)buf;
+  if (size < EI_NIDENT || memcmp(ident, ELFMAG, SELFMAG) != 0)
+    fprintf(stderr, "warning: %s is not an ELF file\n", filename);
+  else if (ident[EI_CLASS] == ELFCLASS64)
+    load<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(ident, size);
+  else
+    load<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(ident, size);
+
+  munmap(buf, size);
+
+  std::sort(symbols.begin(), symbols.end(),
+            [](const symbol_t& a, const symbol_t& b) { return a.addr < b.addr; });
+
+  // unsized symbols (e.g. assembly labels) extend to the next symbol
+  for (size_t i = 0; i + 1 < symbols.size(); i++)
+    if (symbols[i].size == 0)
+      symbols[i].size = symbols[i+1].addr - symbols[i].addr;
+}
+
+template<class Ehdr, class Shdr, class Sym>
+void symtab_t::load(const char* buf, size_t size)
+{
+  const Ehdr* eh = (const Ehdr*)buf;
+  if (eh->e_shoff == 0 || eh->e_shoff + eh->e_shnum * sizeof(Shdr) > size)
+    return;
+
+  const Shdr* sh = (const Shdr*)(buf + eh->e_shoff);
+  for (unsigned i = 0; i < eh->e_shnum; i++)
+  {
+    if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+      continue;
+
+    const Shdr& strtab = sh[sh[i].sh_link];
+    if (sh[i].sh_offset + sh[i].sh_size > size || strtab.sh_offset + strtab.sh_size > size)
+      continue;
+
+    const Sym* sym = (const Sym*)(buf + sh[i].sh_offset);
+    const char* strs = buf + strtab.sh_offset;
+    for (size_t j = 0; j < sh[i].sh_size / sizeof(Sym); j++)
+    {
+      int type = sym[j].st_info & 0xf;
+      if (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE)
+        continue;
+      if (sym[j].st_shndx == SHN_UNDEF || sym[j].st_shndx >= SHN_LORESERVE)
+        continue;
+      if (sym[j].st_name >= strtab.sh_size || !strs[sym[j].st_name])
+        continue;
+      symbols.push_back((symbol_t){sym[j].st_value, sym[j].st_size, strs + sym[j].st_name});
+    }
+  }
+}
+
+const symbol_t* symtab_t::lookup(uint64_t addr) const
+{
+  auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                             [](uint64_t a, const symbol_t& s) { return a < s.addr; });
+  if (it == symbols.begin())
+    return NULL;
+  --it;
+  return addr - it->addr < std::max(it->size, uint64_t(1)) ? &*it : NULL;
+}
+
+std::string symtab_t::describe(uint64_t addr) const
+{
+  const symbol_t* s = lookup(addr);
+  if (!s)
+    return "";
+  if (addr == s->addr)
+    return s->name;
+
+  char offset[32];
+  snprintf(offset, sizeof(offset), "+0x%llx", (unsigned long long)(addr - s->addr));
+  return s->name + offset;
+}
@@ -0,0 +1,37 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_SYMTAB_H
+#define _RISCV_SYMTAB_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct symbol_t
+{
+  uint64_t addr;
+  uint64_t size;
+  std::string name;
+};
+
+// the function and object symbols of a guest ELF file, for attributing
+// guest addresses to the code or data they belong to
+class symtab_t
+{
+ public:
+  symtab_t(const char* filename);
+
+  // the symbol containing addr, or NULL if there is none
+  const symbol_t* lookup(uint64_t addr) const;
+  // "name+0xoffset", or "" if addr isn't covered by a symbol
+  std::string describe(uint64_t addr) const;
+  bool empty() const { return symbols.empty(); }
+
+ private:
+  std::vector<symbol_t> symbols; // sorted by address
+
+  template<class Ehdr, class Shdr, class Sym>
+  void load(const char* buf, size_t size);
+};
+
+#endif
@@ -0,0 +1,71 @@
+// See LICENSE for license details.
+
+#include "timing.h"
+#include "cachesim.h"
+#include "tlbsim.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void help()
+{
+  std::cerr << "Timing configurations are comma-separated lists of <param>=<cycles>," << std::endl;
+  std::cerr << "where <param> is an instruction class:" << std::endl;
+  std::cerr << " ";
+  for (int i = 0; i < NUM_INSN_CLASSES; i++)
+    std::cerr << " " << insn_class_name[i];
+  std::cerr << std::endl;
+  std::cerr << "or one of" << std::endl;
+  std::cerr << "  taken  penalty for a taken branch or jump" << std::endl;
+  std::cerr << "  trap   penalty for taking a trap or interrupt" << std::endl;
+  std::cerr << "  ic     I$ hit latency beyond the instruction's own latency" << std::endl;
+  std::cerr << "  dc     D$ hit latency beyond the instruction's own latency" << std::endl;
+  std::cerr << "  l2     L2$ hit latency" << std::endl;
+  std::cerr << "  mem    memory latency" << std::endl;
+  exit(1);
+}
+
+timing_model_t::timing_model_t(const char* config)
+{
+  static const unsigned defaults[NUM_INSN_CLASSES] = {
+    1, 3, 20, 1, 1, 4, 1, 1, 4, 20, 1, 1, 1
+  };
+  for (int i = 0; i < NUM_INSN_CLASSES; i++)
+    params[insn_class_name[i]] = defaults[i];
+  params["taken"] = 2;
+  params["trap"] = 10;
+  params["ic"] = 0;
+  params["dc"] = 0;
+  params["l2"] = 10;
+  params["mem"] = 100;
+
+  if (strcmp(config, "default") == 0)
+    config = "";
+  for (const char* p = config; *p; )
+  {
+    const char* eq = strchr(p, '=');
+    if (!eq)
+      help();
+    std::string param(p, eq);
+    if (!params.count(param))
+      help();
+    params[param] = atoi(eq + 1);
+
+    p = strchr(eq, ',');
+    p = p ? p + 1 : eq + strlen(eq);
+  }
+
+  for (int i = 0; i < NUM_INSN_CLASSES; i++)
+    latency[i] = params[insn_class_name[i]];
+  redirect_penalty = params["taken"];
+}
+
+uint64_t timing_model_t::memory_stalls()
+{
+  uint64_t stalls = 0;
+  for (auto t : memtracers)
+    stalls += t->get_stall_cycles();
+  for (auto t : tlbs)
+    stalls += t->get_walk_latency();
+  return stalls;
+}
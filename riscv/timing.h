@@ -0,0 +1,45 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_TIMING_H
+#define _RISCV_TIMING_H
+
+#include "processor.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class cache_memtracer_t;
+class tlb_sim_t;
+
+// a cycle-approximate timing model: each retired instruction costs a
+// fixed latency for its class, plus a penalty if it redirects the PC,
+// plus the latency of its accesses to the attached cache models, including
+// those of the page table walks of the attached TLB models.
+class timing_model_t
+{
+ public:
+  // config is a comma-separated list of <param>=<cycles>; see help()
+  timing_model_t(const char* config);
+
+  uint64_t cycles(insn_class_t cls, bool redirect)
+  {
+    return latency[cls] + (redirect ? redirect_penalty : 0);
+  }
+  unsigned trap_penalty() { return get("trap"); }
+
+  // latency parameter by name, e.g. "l2" or "mem"
+  unsigned get(const std::string& param) { return params.at(param); }
+
+  void add_memtracer(cache_memtracer_t* t) { memtracers.push_back(t); }
+  void add_tlb(tlb_sim_t* t) { tlbs.push_back(t); }
+  uint64_t memory_stalls();
+
+ private:
+  std::map<std::string, unsigned> params;
+  unsigned latency[NUM_INSN_CLASSES];
+  unsigned redirect_penalty;
+  std::vector<cache_memtracer_t*> memtracers;
+  std::vector<tlb_sim_t*> tlbs;
+};
+
+#endif
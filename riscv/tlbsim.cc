@@ -0,0 +1,172 @@
+// See LICENSE for license details.
+
+#include "tlbsim.h"
+#include "common.h"
+#include "stats.h"
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+static void help()
+{
+  std::cerr << "TLB configurations must be of the form" << std::endl;
+  std::cerr << "  entries:ways[:pgsize,...]" << std::endl;
+  std::cerr << "where entries and ways are positive integers, entries is a multiple of" << std::endl;
+  std::cerr << "ways, entries/ways is a power of two, and the page sizes (4K, 2M, 4M," << std::endl;
+  std::cerr << "1G, ...) are powers of two of at least 4K. By default a TLB holds pages" << std::endl;
+  std::cerr << "of all sizes." << std::endl;
+  exit(1);
+}
+
+static uint64_t parse_pgsizes(const char* p)
+{
+  uint64_t pgsizes = 0;
+  while (*p)
+  {
+    char* end;
+    uint64_t size = strtoull(p, &end, 0);
+    switch (*end)
+    {
+      case 'K': case 'k': size <<= 10; end++; break;
+      case 'M': case 'm': size <<= 20; end++; break;
+      case 'G': case 'g': size <<= 30; end++; break;
+    }
+    if (size < 4096 || (size & (size-1)) || (*end && *end != ','))
+      help();
+
+    int shift = 0;
+    while ((uint64_t(1) << shift) < size)
+      shift++;
+    pgsizes |= uint64_t(1) << shift;
+    p = *end ? end + 1 : end;
+  }
+  return pgsizes;
+}
+
+tlb_sim_t* tlb_sim_t::construct(const char* config, const char* name)
+{
+  const char* wp = strchr(config, ':');
+  if (!wp++) help();
+  const char* sp = strchr(wp, ':');
+
+  size_t entries = atoi(std::string(config, wp).c_str());
+  size_t ways = atoi(sp ? std::string(wp, sp).c_str() : wp);
+  uint64_t pgsizes = sp ? parse_pgsizes(sp + 1) : ~uint64_t(4095);
+
+  if (entries == 0 || ways == 0 || entries % ways != 0 || pgsizes == 0)
+    help();
+  return new tlb_sim_t(entries / ways, ways, pgsizes, name);
+}
+
+tlb_sim_t::tlb_sim_t(size_t _sets, size_t _ways, uint64_t _pgsizes, const char* _name)
+ : miss_handler(NULL), walk_cache(NULL), sets(_sets), ways(_ways),
+   pgsizes(_pgsizes), name(_name)
+{
+  if (sets & (sets-1))
+    help();
+
+  tags = new uint64_t[sets*ways]();
+  accesses = 0;
+  misses = 0;
+  superpage_accesses = 0;
+  splintered_fills = 0;
+  walks = 0;
+  walk_reads = 0;
+  walk_latency = 0;
+}
+
+tlb_sim_t::~tlb_sim_t()
+{
+  print_stats();
+  delete [] tags;
+}
+
+void tlb_sim_t::flush()
+{
+  memset(tags, 0, sets*ways*sizeof(uint64_t));
+}
+
+bool tlb_sim_t::access(const translation_t& t, uint64_t pc)
+{
+  accesses++;
+  if (t.pgsize > 4096)
+    superpage_accesses++;
+
+  // the largest page size we hold that fits in the mapping, if any
+  uint64_t fits = pgsizes & ((t.pgsize << 1) - 1);
+  int shift = fits ? 63 - __builtin_clzll(fits) : 0;
+  uint64_t vpn = t.vaddr >> shift;
+  uint64_t* set = &tags[(vpn & (sets-1)) * ways];
+  uint64_t tag = VALID | vpn << 6 | shift;
+
+  if (likely(fits))
+    for (size_t i = 0; i < ways; i++)
+      if (set[i] == tag)
+        return true;
+
+  misses++;
+  bool hit = miss_handler && miss_handler->access(t, pc);
+
+  if (!miss_handler)
+  {
+    walks++;
+    walk_reads += t.levels;
+    if (walk_cache)
+      for (unsigned i = 0; i < t.levels; i++)
+        walk_latency += walk_cache->access(t.pte_addr[i], t.ptesize, false, pc);
+  }
+
+  if (likely(fits))
+  {
+    if ((uint64_t(1) << shift) < t.pgsize)
+      splintered_fills++;
+    set[lfsr.next() % ways] = tag;
+  }
+
+  return hit;
+}
+
+void tlb_sim_t::print_stats()
+{
+  if (accesses == 0)
+    return;
+
+  float mr = 100.0f*misses/accesses;
+  float sp = 100.0f*superpage_accesses/accesses;
+
+  std::cout << std::setprecision(3) << std::fixed;
+  std::cout << name << " ";
+  std::cout << "Accesses:              " << accesses << std::endl;
+  std::cout << name << " ";
+  std::cout << "Misses:                " << misses << std::endl;
+  std::cout << name << " ";
+  std::cout << "Miss Rate:             " << mr << '%' << std::endl;
+  std::cout << name << " ";
+  std::cout << "Superpage Accesses:    " << sp << '%' << std::endl;
+  std::cout << name << " ";
+  std::cout << "Splintered Fills:      " << splintered_fills << std::endl;
+
+  if (miss_handler)
+    return;
+
+  std::cout << name << " ";
+  std::cout << "Page Walks:            " << walks << std::endl;
+  std::cout << name << " ";
+  std::cout << "Walk PTE Reads:        " << walk_reads << std::endl;
+  if (walk_latency)
+  {
+    std::cout << name << " ";
+    std::cout << "Avg Walk Latency:      " << float(walk_latency)/walks << " cycles" << std::endl;
+  }
+}
+
+void tlb_sim_t::register_stats(stats_t* stats)
+{
+  stats->add(name + ".accesses", &accesses);
+  stats->add(name + ".misses", &misses);
+  stats->add(name + ".superpage_accesses", &superpage_accesses);
+  stats->add(name + ".splintered_fills", &splintered_fills);
+  stats->add(name + ".walks", &walks);
+  stats->add(name + ".walk_reads", &walk_reads);
+  stats->add(name + ".walk_latency", &walk_latency);
+}
@@ -0,0 +1,110 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_TLB_SIM_H
+#define _RISCV_TLB_SIM_H
+
+#include "memtracer.h"
+#include "cachesim.h"
+#include <cstdint>
+#include <string>
+
+class stats_t;
+
+// a set-associative TLB that holds mappings of the page sizes it supports.
+// a superpage mapping is splintered into the largest supported page size
+// that fits in it. misses go to the next-level TLB or, in the last level,
+// to a page table walk whose PTE reads are fed to a cache model.
+class tlb_sim_t
+{
+ public:
+  tlb_sim_t(size_t sets, size_t ways, uint64_t pgsizes, const char* name);
+  ~tlb_sim_t();
+
+  // look up the mapping of t.vaddr, refilling it on a miss; returns true
+  // if this TLB or a lower level held the mapping
+  bool access(const translation_t& t, uint64_t pc);
+  void flush();
+  void print_stats();
+  void register_stats(stats_t* stats);
+  void set_miss_handler(tlb_sim_t* mh) { miss_handler = mh; }
+  void set_walk_cache(cache_sim_t* c) { walk_cache = c; }
+  uint64_t get_walk_latency() { return walk_latency; }
+
+  // entries:ways[:pgsize,...], e.g. 64:4:4K,2M
+  static tlb_sim_t* construct(const char* config, const char* name);
+
+ private:
+  static const uint64_t VALID = 1ULL << 63;
+
+  lfsr_t lfsr;
+  tlb_sim_t* miss_handler;
+  cache_sim_t* walk_cache;
+
+  size_t sets;
+  size_t ways;
+  uint64_t pgsizes; // bitmask of the log2 page sizes held
+  uint64_t* tags;   // VALID | vpn << 6 | log2 page size
+
+  uint64_t accesses;
+  uint64_t misses;
+  uint64_t superpage_accesses;
+  uint64_t splintered_fills;
+  uint64_t walks;
+  uint64_t walk_reads;
+  uint64_t walk_latency;
+
+  std::string name;
+};
+
+class tlb_memtracer_t : public memtracer_t
+{
+ public:
+  tlb_memtracer_t(const char* config, const char* name, bool fetch)
+    : fetch(fetch)
+  {
+    tlb = tlb_sim_t::construct(config, name);
+  }
+  ~tlb_memtracer_t()
+  {
+    delete tlb;
+  }
+  tlb_sim_t* get_tlb() { return tlb; }
+
+  bool interested_in_range(uint64_t begin, uint64_t end, bool store, bool fetch)
+  {
+    return false;
+  }
+  void trace(uint64_t addr, size_t bytes, bool store, bool fetch, uint64_t vaddr, uint64_t pc)
+  {
+  }
+  bool interested_in_translation(bool fetch)
+  {
+    return fetch == this->fetch;
+  }
+  void translate(const translation_t& t, bool store, bool fetch, uint64_t pc)
+  {
+    tlb->access(t, pc);
+  }
+  void flush_translations()
+  {
+    tlb->flush();
+  }
+
+ private:
+  tlb_sim_t* tlb;
+  bool fetch;
+};
+
+class itlb_sim_t : public tlb_memtracer_t
+{
+ public:
+  itlb_sim_t(const char* config) : tlb_memtracer_t(config, "ITLB", true) {}
+};
+
+class dtlb_sim_t : public tlb_memtracer_t
+{
+ public:
+  dtlb_sim_t(const char* config) : tlb_memtracer_t(config, "DTLB", false) {}
+};
+
+#endif
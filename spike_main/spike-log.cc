@@ -0,0 +1,97 @@
+// See LICENSE for license details.
+
+// This little program prints a binary commit log, as written by
+// spike --log-commits, in the same format as spike's text logs:
+//  core   0: 0x0000000000002000 (0x00000297) x 5 0x0000000000002000
+// optionally followed by the address the instruction accessed and its
+// disassembly.
+
+#include "commitlog.h"
+#include "disasm.h"
+#include "extension.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <fesvr/option_parser.h>
+
+static void help()
+{
+  fprintf(stderr, "usage: spike-log [--disasm] [--extension=<name>] [<log file>]\n");
+  fprintf(stderr, "Reads the log from stdin if no file is given.\n");
+  exit(1);
+}
+
+static void truncated()
+{
+  fprintf(stderr, "spike-log: the commit log is truncated\n");
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  bool show_disasm = false;
+  std::function<extension_t*()> extension;
+  option_parser_t parser;
+  parser.help(&help);
+  parser.option('h', 0, 0, [&](const char* s){help();});
+  parser.option(0, "disasm", 0, [&](const char* s){show_disasm = true;});
+  parser.option(0, "extension", 1, [&](const char* s){extension = find_extension(s);});
+  auto argv1 = parser.parse(argv);
+
+  FILE* f = *argv1 ? fopen(*argv1, "rb") : stdin;
+  if (!f)
+  {
+    fprintf(stderr, "spike-log: couldn't open %s\n", *argv1);
+    return 1;
+  }
+
+  disassembler_t d;
+  if (extension)
+    for (auto disasm_insn : extension()->get_disasms())
+      d.add_insn(disasm_insn);
+
+  char magic[sizeof(COMMIT_LOG_MAGIC) - 1];
+  if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, COMMIT_LOG_MAGIC, sizeof(magic)) != 0)
+  {
+    fprintf(stderr, "spike-log: not a commit log\n");
+    return 1;
+  }
+
+  // the little-endian value of the next given number of bytes
+  auto get = [&](size_t bytes) {
+    uint8_t buf[8];
+    if (fread(buf, bytes, 1, f) != 1)
+      truncated();
+    return commit_log_get(buf, bytes);
+  };
+
+  commit_log_header_t h;
+  uint8_t header[COMMIT_LOG_HEADER_SIZE];
+  while (fread(header, sizeof(header), 1, f) == 1)
+  {
+    h.decode(header);
+    size_t length = h.flags & COMMIT_LOG_INSN16 ? 2 : h.flags & COMMIT_LOG_INSN64 ? 8 : 4;
+    uint64_t bits = get(length);
+    uint64_t value = h.flags & COMMIT_LOG_RD ? get(8) : 0;
+    uint64_t addr = h.flags & COMMIT_LOG_ADDR ? get(8) : 0;
+
+    printf("core %3d: 0x%016" PRIx64 " (0x%08" PRIx64 ")", h.hart, h.pc, bits);
+    if (h.flags & COMMIT_LOG_RD)
+      printf(" %c%2d 0x%016" PRIx64, h.flags & COMMIT_LOG_FRD ? 'f' : 'x', h.rd, value);
+    if (h.flags & COMMIT_LOG_ADDR)
+      printf(" mem 0x%016" PRIx64, addr);
+    if (show_disasm)
+    {
+      // the disassembler expects the instruction bits sign-extended
+      if (length == 2)
+        bits = int16_t(bits);
+      else if (length == 4)
+        bits = int32_t(bits);
+      printf(" %s", d.disassemble(bits).c_str());
+    }
+    putchar('\n');
+  }
+
+  return 0;
+}
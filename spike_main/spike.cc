@@ -3,15 +3,28 @@
 #include "sim.h"
 #include "htif.h"
 #include "cachesim.h"
+#include "symtab.h"
+#include "timing.h"
+#include "commitlog.h"
+#include "bbv.h"
+#include "profiler.h"
+#include "tlbsim.h"
+#include "stats.h"
+#include "hostprof.h"
+#include "blkdev.h"
+#include "console.h"
 #include "extension.h"
 #include <dlfcn.h>
+#include <unistd.h>
 #include <fesvr/option_parser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <vector>
 #include <string>
 #include <memory>
+#include <algorithm>
 
 static void help()
 {
@@ -20,26 +33,180 @@ static void help()
   fprintf(stderr, "  -p <n>             Simulate <n> processors [default 1]\n");
   fprintf(stderr, "  -m <n>             Provide <n> MiB of target memory [default 4096]\n");
   fprintf(stderr, "  -d                 Interactive debug mode\n");
-  fprintf(stderr, "  -g                 Track histogram of PCs\n");
+  fprintf(stderr, "  -g                 Track histogram of PCs, also aggregated by symbol if\n");
+  fprintf(stderr, "                       --symbols is given\n");
   fprintf(stderr, "  -h                 Print this help message\n");
   fprintf(stderr, "  --isa=<name>       RISC-V ISA string [default RV64IMAFDC]\n");
+  fprintf(stderr, "  --log-commits=<file> Write a binary log of retired instructions to <file>;\n");
+  fprintf(stderr, "                       spike-log decodes it\n");
+  fprintf(stderr, "  --bbv=<file>:<N>   Write SimPoint basic-block vectors for every interval\n");
+  fprintf(stderr, "                       of N instructions to <file> (<file>.<core> if -p>1)\n");
+  fprintf(stderr, "  --profile=<file>:<N> Sample the PC every N instructions and write call\n");
+  fprintf(stderr, "                       stacks in folded format to <file> (<file>.<core> if\n");
+  fprintf(stderr, "                       -p>1), resolved against the --symbols ELF file\n");
+  fprintf(stderr, "  --checkpoint=<file>:<N>[:<M>] Save the state of the machine to <file> after\n");
+  fprintf(stderr, "                       N instructions and then, if M is given, the pages\n");
+  fprintf(stderr, "                       written since the last one to <file>.<k> every M\n");
+  fprintf(stderr, "                       instructions\n");
+  fprintf(stderr, "  --restore=<file>   Resume from a checkpoint once <target program> is loaded\n");
+  fprintf(stderr, "  --fork-sample=<file>:<P>:<W> Every P instructions, fork a process that runs\n");
+  fprintf(stderr, "                       the next W instructions with the instrumentation\n");
+  fprintf(stderr, "                       attached and writes its reports to <file>.<n>, while\n");
+  fprintf(stderr, "                       this one runs on without it; not with --roi, --bbv\n");
+  fprintf(stderr, "                       or --profile\n");
+  fprintf(stderr, "  --fast-forward=<N> Run each core's first N instructions with the\n");
+  fprintf(stderr, "                       instrumentation detached, then attach it (and enter\n");
+  fprintf(stderr, "                       interactive mode, with -d); not with --roi or\n");
+  fprintf(stderr, "                       --fork-sample\n");
+  fprintf(stderr, "  --flight-recorder=<N> Keep each core's last N retired blocks and traps,\n");
+  fprintf(stderr, "                       printed on CTRL+C, on a nonzero exit code, if the\n");
+  fprintf(stderr, "                       simulator dies, and by the interactive history command\n");
+  fprintf(stderr, "  --insn-mix         Count executions per instruction class and opcode\n");
+  fprintf(stderr, "  --stats=<file>[:<N>] Write the simulator's counters to <file> as a JSON object\n");
+  fprintf(stderr, "                       per line, at exit and, if given, every N instructions\n");
+  fprintf(stderr, "  --host-profile     Report the simulator's speed and where its host time goes\n");
+  fprintf(stderr, "  --roi              Collect statistics and traces only between the guest's\n");
+  fprintf(stderr, "                       ROI markers, slti x0,x0,1 (begin) and slti x0,x0,2 (end)\n");
+  fprintf(stderr, "  --uarch-csrs=<C>,... Let the guest read simulator counter C through uarch<n>\n");
+  fprintf(stderr, "                       for the n-th C in the list, where C is one of\n");
+  fprintf(stderr, "                       decoded-hits-approx (retired instructions less\n");
+  fprintf(stderr, "                       decoded-misses), decoded-misses, tlb-refills,\n");
+  fprintf(stderr, "                       page-walks, traps, ic-misses, dc-misses, l2-misses,\n");
+  fprintf(stderr, "                       ic-accesses, dc-accesses, l2-accesses, or none\n");
+  fprintf(stderr, "                       [default: the first eight, in that order]\n");
   fprintf(stderr, "  --ic=<S>:<W>:<B>   Instantiate a cache model with S sets,\n");
   fprintf(stderr, "  --dc=<S>:<W>:<B>     W ways, and B-byte blocks (with S and\n");
   fprintf(stderr, "  --l2=<S>:<W>:<B>     B both powers of 2).\n");
+  fprintf(stderr, "  --ic-prefetch=<P>  Attach a prefetcher to the I$, D$, or L2$ model,\n");
+  fprintf(stderr, "  --dc-prefetch=<P>    where P is next[:degree], stride[:entries[:degree]],\n");
+  fprintf(stderr, "  --l2-prefetch=<P>    or stream[:streams[:depth]]\n");
+  fprintf(stderr, "  --itlb=<E>:<W>[:<P>] Model an I-TLB, D-TLB, or shared L2 TLB with E\n");
+  fprintf(stderr, "  --dtlb=<E>:<W>[:<P>]   entries in W ways, holding the comma-separated\n");
+  fprintf(stderr, "  --l2tlb=<E>:<W>[:<P>]  page sizes P (e.g. 4K,2M) [default: all]; page\n");
+  fprintf(stderr, "                       walks access the D$ model, or else the L2$ model\n");
+  fprintf(stderr, "  --sample=<F>:<W>:<M> Sample the cache models: repeatedly fast-forward\n");
+  fprintf(stderr, "                       F instructions, warm up for W, and measure M\n");
+  fprintf(stderr, "  --timing=<P>=<C>,... Estimate cycles with a simple timing model that charges\n");
+  fprintf(stderr, "                       C cycles for parameter P (--timing=help lists them,\n");
+  fprintf(stderr, "                       --timing=default keeps the defaults); reported by the\n");
+  fprintf(stderr, "                       cycle CSR and at exit\n");
+  fprintf(stderr, "  --miss-report=<N>  Report the N PCs and data pages causing the most\n");
+  fprintf(stderr, "                       misses in each cache model; append :sym to\n");
+  fprintf(stderr, "                       group data by symbol instead of by virtual page\n");
+  fprintf(stderr, "  --symbols=<elf>    Resolve guest addresses against the symbols in <elf>\n");
+  fprintf(stderr, "                       [default: the target program]\n");
+  fprintf(stderr, "  --blkdev=<image>   Serve a block device backed by <image> as HTIF device 16\n");
+  fprintf(stderr, "  --console          Serve the console in the simulator, buffering its output\n");
+  fprintf(stderr, "  --direct-load      Load <target program> straight into memory and start at\n");
+  fprintf(stderr, "                       its entry point, rather than through the frontend\n");
+  fprintf(stderr, "  --inproc-frontend  Run the frontend on the simulation thread, calling into\n");
+  fprintf(stderr, "                       the machine directly; not with -d or --fork-sample\n");
   fprintf(stderr, "  --extension=<name> Specify RoCC Extension\n");
   fprintf(stderr, "  --extlib=<name>    Shared library to load\n");
   exit(1);
 }
 
+// the simulator counter the guest can read through a uarch CSR
+static std::function<reg_t()> uarch_counter(const std::string& name, processor_t* p,
+                                            cache_sim_t* ic, cache_sim_t* dc, cache_sim_t* l2)
+{
+  mmu_t* mmu = p->get_mmu();
+  // not counted, since the stepping loop chains decoded instructions without
+  // looking them up: every retired instruction is taken to be fetched once
+  if (name == "decoded-hits-approx")
+    return [=](){ return std::max(p->get_state()->minstret, mmu->get_icache_misses()) - mmu->get_icache_misses(); };
+  if (name == "decoded-misses")
+    return [=](){ return mmu->get_icache_misses(); };
+  if (name == "tlb-refills")
+    return [=](){ return mmu->get_tlb_refills(); };
+  if (name == "page-walks")
+    return [=](){ return mmu->get_page_walks(); };
+  if (name == "traps")
+    return [=](){ return p->get_traps(); };
+
+  if (name == "none")
+    return NULL;
+
+  std::string level = name.substr(0, 3), stat = name.substr(std::min(name.size(), size_t(3)));
+  if ((level == "ic-" || level == "dc-" || level == "l2-") && (stat == "misses" || stat == "accesses"))
+  {
+    cache_sim_t* cache = level == "ic-" ? ic : level == "dc-" ? dc : l2;
+    if (!cache) // not modeled, so it reads as zero
+      return NULL;
+    if (stat == "misses")
+      return [=](){ return cache->get_misses(); };
+    return [=](){ return cache->get_accesses(); };
+  }
+
+  fprintf(stderr, "unknown uarch counter %s\n", name.c_str());
+  exit(1);
+}
+
+// the program whose symbols describe guest addresses: under the proxy
+// kernel, the one it runs, which follows pk's own options
+static const char* target_program(const std::vector<std::string>& htif_args)
+{
+  bool pk = false;
+  for (auto& arg : htif_args)
+  {
+    if (arg[0] == '+' || (pk && arg[0] == '-'))
+      continue;
+    size_t slash = arg.rfind('/');
+    if (!pk && arg.compare(slash == std::string::npos ? 0 : slash + 1, std::string::npos, "pk") == 0)
+      pk = true;
+    else
+      return arg.c_str();
+  }
+  return NULL;
+}
+
 int main(int argc, char** argv)
 {
   bool debug = false;
   bool histogram = false;
+  bool insn_mix = false;
+  bool roi = false;
+  bool inproc_frontend = false;
+  bool direct_load = false;
+  std::unique_ptr<blkdev_t> blkdev;
+  std::unique_ptr<console_t> console;
+  size_t flight_recorder = 0;
+  uint64_t fast_forward = 0;
+  std::string checkpoint_file;
+  uint64_t checkpoint_insns = 0, checkpoint_interval = 0;
+  const char* restore_file = NULL;
+  std::string fork_file;
+  uint64_t fork_period = 0, fork_window = 0;
+  std::string log_file, stats_file;
+  const char* uarch_csrs = "decoded-hits-approx,decoded-misses,tlb-refills,page-walks,traps,"
+                           "ic-misses,dc-misses,l2-misses";
   size_t nprocs = 1;
   size_t mem_mb = 0;
+  std::unique_ptr<symtab_t> symbols;
+  const char* symbols_file = NULL;
+  std::unique_ptr<commit_log_t> commit_log;
+  std::vector<std::unique_ptr<bbv_t>> bbvs;
+  std::string bbv_file;
+  uint64_t bbv_interval = 0;
+  std::vector<std::unique_ptr<profiler_t>> profilers;
+  std::string profile_file;
+  uint64_t profile_period = 0;
   std::unique_ptr<icache_sim_t> ic;
   std::unique_ptr<dcache_sim_t> dc;
   std::unique_ptr<cache_sim_t> l2;
+  std::unique_ptr<itlb_sim_t> itlb;
+  std::unique_ptr<dtlb_sim_t> dtlb;
+  std::unique_ptr<tlb_sim_t> l2tlb;
+  std::unique_ptr<cache_sampler_t> sampler;
+  std::unique_ptr<stats_t> stats;
+  bool host_profile = false;
+  std::unique_ptr<host_profiler_t> host_profiler; // outlives the sim_t
+  std::unique_ptr<timing_model_t> timing;
+  const char* ic_prefetch = NULL;
+  const char* dc_prefetch = NULL;
+  const char* l2_prefetch = NULL;
+  size_t miss_report = 0;
+  bool miss_report_symbols = false;
   std::function<extension_t*()> extension;
   const char* isa = "RV64";
 
@@ -50,9 +217,87 @@ int main(int argc, char** argv)
   parser.option('g', 0, 0, [&](const char* s){histogram = true;});
   parser.option('p', 0, 1, [&](const char* s){nprocs = atoi(s);});
   parser.option('m', 0, 1, [&](const char* s){mem_mb = atoi(s);});
+  parser.option(0, "log-commits", 1, [&](const char* s){
+    log_file = s;
+    commit_log.reset(new commit_log_t(s));
+  });
+  parser.option(0, "bbv", 1, [&](const char* s){
+    const char* colon = strrchr(s, ':');
+    bbv_interval = colon ? strtoull(colon + 1, NULL, 0) : 0;
+    if (bbv_interval == 0)
+      help();
+    bbv_file = std::string(s, colon);
+  });
+  parser.option(0, "profile", 1, [&](const char* s){
+    const char* colon = strrchr(s, ':');
+    profile_period = colon ? strtoull(colon + 1, NULL, 0) : 0;
+    if (profile_period == 0)
+      help();
+    profile_file = std::string(s, colon);
+  });
+  parser.option(0, "stats", 1, [&](const char* s){
+    const char* colon = strrchr(s, ':');
+    uint64_t interval = colon ? strtoull(colon + 1, NULL, 0) : 0;
+    if (colon && interval == 0)
+      help();
+    stats_file = colon ? std::string(s, colon) : std::string(s);
+    stats.reset(new stats_t(stats_file.c_str(), interval));
+  });
+  parser.option(0, "checkpoint", 1, [&](const char* s){
+    std::string arg(s);
+    size_t colon = arg.find(':');
+    if (colon == std::string::npos)
+      help();
+    char* end;
+    checkpoint_insns = strtoull(arg.c_str() + colon + 1, &end, 0);
+    checkpoint_interval = *end == ':' ? strtoull(end + 1, NULL, 0) : 0;
+    if (checkpoint_insns == 0 || (*end && checkpoint_interval == 0))
+      help();
+    checkpoint_file = arg.substr(0, colon);
+  });
+  parser.option(0, "fork-sample", 1, [&](const char* s){
+    std::string arg(s);
+    size_t colon2 = arg.rfind(':');
+    size_t colon1 = colon2 && colon2 != std::string::npos ? arg.rfind(':', colon2 - 1) : std::string::npos;
+    if (colon1 == std::string::npos)
+      help();
+    fork_period = strtoull(arg.c_str() + colon1 + 1, NULL, 0);
+    fork_window = strtoull(arg.c_str() + colon2 + 1, NULL, 0);
+    if (fork_period == 0 || fork_window == 0)
+      help();
+    fork_file = arg.substr(0, colon1);
+  });
+  parser.option(0, "restore", 1, [&](const char* s){restore_file = s;});
+  parser.option(0, "fast-forward", 1, [&](const char* s){
+    fast_forward = strtoull(s, NULL, 0);
+    if (fast_forward == 0)
+      help();
+  });
+  parser.option(0, "flight-recorder", 1, [&](const char* s){flight_recorder = strtoull(s, NULL, 0);});
+  parser.option(0, "insn-mix", 0, [&](const char* s){insn_mix = true;});
+  parser.option(0, "host-profile", 0, [&](const char* s){host_profile = true;});
+  parser.option(0, "roi", 0, [&](const char* s){roi = true;});
+  parser.option(0, "uarch-csrs", 1, [&](const char* s){uarch_csrs = s;});
   parser.option(0, "ic", 1, [&](const char* s){ic.reset(new icache_sim_t(s));});
   parser.option(0, "dc", 1, [&](const char* s){dc.reset(new dcache_sim_t(s));});
   parser.option(0, "l2", 1, [&](const char* s){l2.reset(cache_sim_t::construct(s, "L2$"));});
+  parser.option(0, "itlb", 1, [&](const char* s){itlb.reset(new itlb_sim_t(s));});
+  parser.option(0, "dtlb", 1, [&](const char* s){dtlb.reset(new dtlb_sim_t(s));});
+  parser.option(0, "l2tlb", 1, [&](const char* s){l2tlb.reset(tlb_sim_t::construct(s, "L2TLB"));});
+  parser.option(0, "ic-prefetch", 1, [&](const char* s){ic_prefetch = s;});
+  parser.option(0, "dc-prefetch", 1, [&](const char* s){dc_prefetch = s;});
+  parser.option(0, "l2-prefetch", 1, [&](const char* s){l2_prefetch = s;});
+  parser.option(0, "timing", 1, [&](const char* s){timing.reset(new timing_model_t(s));});
+  parser.option(0, "miss-report", 1, [&](const char* s){
+    miss_report = atoi(s);
+    miss_report_symbols = strstr(s, ":sym") != NULL;
+  });
+  parser.option(0, "symbols", 1, [&](const char* s){symbols_file = s;});
+  parser.option(0, "sample", 1, [&](const char* s){sampler.reset(new cache_sampler_t(s));});
+  parser.option(0, "blkdev", 1, [&](const char* s){blkdev.reset(new blkdev_t(s));});
+  parser.option(0, "console", 0, [&](const char* s){console.reset(new console_t);});
+  parser.option(0, "direct-load", 0, [&](const char* s){direct_load = true;});
+  parser.option(0, "inproc-frontend", 0, [&](const char* s){inproc_frontend = true;});
   parser.option(0, "isa", 1, [&](const char* s){isa = s;});
   parser.option(0, "extension", 1, [&](const char* s){extension = find_extension(s);});
   parser.option(0, "extlib", 1, [&](const char *s){
@@ -67,18 +312,161 @@ int main(int argc, char** argv)
   if (!*argv1)
     help();
   std::vector<std::string> htif_args(argv1, (const char*const*)argv + argc);
-  sim_t s(isa, nprocs, mem_mb, htif_args);
+  if (inproc_frontend && (debug || fork_period))
+    help();
+  sim_t s(isa, nprocs, mem_mb, htif_args, inproc_frontend);
 
+  bool histogram_symbols = histogram && symbols_file;
+  if (!symbols_file)
+    symbols_file = target_program(htif_args);
+  if ((miss_report || histogram_symbols || profile_period) && symbols_file)
+    symbols.reset(new symtab_t(symbols_file));
+
+  if (miss_report)
+  {
+    if (ic) ic->get_cache()->set_attribution(miss_report, symbols.get(), miss_report_symbols);
+    if (dc) dc->get_cache()->set_attribution(miss_report, symbols.get(), miss_report_symbols);
+    if (l2) l2->set_attribution(miss_report, symbols.get(), miss_report_symbols);
+  }
+
+  if (ic && ic_prefetch) ic->get_cache()->set_prefetcher(prefetcher_t::construct(ic_prefetch));
+  if (dc && dc_prefetch) dc->get_cache()->set_prefetcher(prefetcher_t::construct(dc_prefetch));
+  if (l2 && l2_prefetch) l2->set_prefetcher(prefetcher_t::construct(l2_prefetch));
   if (ic && l2) ic->set_miss_handler(&*l2);
   if (dc && l2) dc->set_miss_handler(&*l2);
+
+  cache_sim_t* walk_cache = dc ? dc->get_cache() : l2 ? &*l2 : NULL;
+  if (l2tlb) l2tlb->set_walk_cache(walk_cache);
+  if (itlb) itlb->get_tlb()->set_walk_cache(walk_cache);
+  if (dtlb) dtlb->get_tlb()->set_walk_cache(walk_cache);
+  if (itlb && l2tlb) itlb->get_tlb()->set_miss_handler(&*l2tlb);
+  if (dtlb && l2tlb) dtlb->get_tlb()->set_miss_handler(&*l2tlb);
+
   for (size_t i = 0; i < nprocs; i++)
   {
     if (ic) s.get_core(i)->get_mmu()->register_memtracer(&*ic);
     if (dc) s.get_core(i)->get_mmu()->register_memtracer(&*dc);
+    if (itlb) s.get_core(i)->get_mmu()->register_memtracer(&*itlb);
+    if (dtlb) s.get_core(i)->get_mmu()->register_memtracer(&*dtlb);
     if (extension) s.get_core(i)->register_extension(extension());
+    if (bbv_interval)
+    {
+      std::string name = nprocs == 1 ? bbv_file : bbv_file + "." + std::to_string(i);
+      bbvs.emplace_back(new bbv_t(name.c_str(), bbv_interval));
+      s.get_core(i)->set_bbv(&*bbvs.back());
+    }
+    if (profile_period)
+    {
+      std::string name = nprocs == 1 ? profile_file : profile_file + "." + std::to_string(i);
+      profilers.emplace_back(new profiler_t(name.c_str(), profile_period, symbols.get()));
+      s.get_core(i)->set_profiler(&*profilers.back());
+    }
+  }
+
+  if (timing)
+  {
+    if (ic) ic->get_cache()->set_latency(timing->get("ic"), timing->get("mem"));
+    if (dc) dc->get_cache()->set_latency(timing->get("dc"), timing->get("mem"));
+    if (l2) l2->set_latency(timing->get("l2"), timing->get("mem"));
+    if (ic) timing->add_memtracer(&*ic);
+    if (dc) timing->add_memtracer(&*dc);
+    if (itlb) timing->add_tlb(itlb->get_tlb());
+    if (dtlb) timing->add_tlb(dtlb->get_tlb());
+    if (l2tlb) timing->add_tlb(&*l2tlb);
+    s.set_timing_model(&*timing);
+  }
+
+  if (sampler)
+  {
+    if (ic) sampler->add_cache(ic->get_cache());
+    if (dc) sampler->add_cache(dc->get_cache());
+    if (l2) sampler->add_cache(&*l2);
+    s.set_cache_sampler(&*sampler);
+  }
+
+  std::vector<std::string> uarch_names;
+  for (const char* p = uarch_csrs; *p; )
+  {
+    const char* comma = strchr(p, ',');
+    uarch_names.push_back(comma ? std::string(p, comma) : std::string(p));
+    p = comma ? comma + 1 : p + strlen(p);
+  }
+  if (uarch_names.size() > 16)
+    help();
+  for (size_t i = 0; i < nprocs; i++)
+    for (size_t n = 0; n < uarch_names.size(); n++)
+      s.get_core(i)->set_uarch_counter(n, uarch_counter(uarch_names[n], s.get_core(i),
+          ic ? ic->get_cache() : NULL, dc ? dc->get_cache() : NULL, l2.get()));
+
+  if (stats)
+  {
+    s.set_stats(&*stats);
+    if (ic) ic->get_cache()->register_stats(&*stats);
+    if (dc) dc->get_cache()->register_stats(&*stats);
+    if (l2) l2->register_stats(&*stats);
+    if (itlb) itlb->get_tlb()->register_stats(&*stats);
+    if (dtlb) dtlb->get_tlb()->register_stats(&*stats);
+    if (l2tlb) l2tlb->register_stats(&*stats);
   }
 
+  if (commit_log)
+    s.set_commit_log(&*commit_log);
+
+  s.set_direct_load(direct_load);
+  if (blkdev)
+    s.register_device(blkdev_t::DEVICE, &*blkdev);
+  if (console)
+    s.register_device(console_t::DEVICE, &*console);
+  s.set_insn_mix(insn_mix);
+  s.set_roi_markers(roi);
+  s.set_flight_recorder(flight_recorder);
+  if (fast_forward)
+  {
+    if (roi || fork_period)
+      help();
+    s.set_fast_forward(fast_forward);
+  }
+  if (checkpoint_insns)
+    s.set_checkpoint(checkpoint_file.c_str(), checkpoint_insns, checkpoint_interval);
+  if (restore_file)
+    s.set_restore(restore_file);
+  if (fork_period)
+  {
+    if (roi || bbv_interval || profile_period)
+      help();
+    s.set_fork_sampling(fork_period, fork_window, sysconf(_SC_NPROCESSORS_ONLN), [&](size_t n){
+      std::string suffix = "." + std::to_string(n);
+      if (!freopen((fork_file + suffix).c_str(), "w", stdout))
+      {
+        fprintf(stderr, "couldn't open %s\n", (fork_file + suffix).c_str());
+        exit(1);
+      }
+      dup2(fileno(stdout), fileno(stderr));
+      if (commit_log)
+        commit_log->reopen((log_file + suffix).c_str());
+      if (stats)
+        stats->reopen((stats_file + suffix).c_str());
+    });
+  }
   s.set_debug(debug);
-  s.set_histogram(histogram);
-  return s.run();
+  s.set_histogram(histogram, histogram_symbols ? symbols.get() : NULL);
+
+  if (host_profile)
+  {
+    host_profiler.reset(new host_profiler_t);
+    s.set_host_profiler(&*host_profiler);
+  }
+
+  int exit_code = s.run();
+  if (exit_code)
+    s.print_flight_recorders(stderr);
+  stats.reset();
+  if (host_profiler)
+  {
+    uint64_t insns = 0;
+    for (size_t i = 0; i < s.num_cores(); i++)
+      insns += s.get_core(i)->get_state()->minstret;
+    host_profiler->print(stderr, insns);
+  }
+  return exit_code;
 }